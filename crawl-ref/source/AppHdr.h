@@ -225,7 +225,9 @@ static inline double pow(int x, double y) { return std::pow((double)x, y); }
 
     // Update (text) database files safely; when a Crawl process
     // starts up and notices that a db file is out-of-date, it updates
-    // it in-place, instead of torching the old file.
+    // it in-place, instead of torching the old file. Only for dbm
+    // libraries other than SQLite, whose dbs are always rebuilt in a
+    // temporary file and renamed into place.
     #define DGL_REWRITE_PROTECT_DB_FILES
 
     // Startup preferences are saved by player name rather than uid,
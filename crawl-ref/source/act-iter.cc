@@ -4,6 +4,17 @@
 
 #include "env.h"
 #include "losglobal.h"
+#include "mon-util.h"
+
+// The next monster slot after i that might hold a monster in range of
+// centre; only monsters within LOS_RADIUS can be seen, unless no LOS is
+// required at all.
+static int _next_near_slot(const coord_def &centre, los_type los, int i)
+{
+    if (los == LOS_NONE)
+        return mons_index_next(i);
+    return mons_index_next_near(centre, LOS_RADIUS, i);
+}
 
 actor_near_iterator::actor_near_iterator(coord_def c, los_type los)
     : center(c), _los(los), viewer(nullptr), i(-1)
@@ -64,7 +75,7 @@ bool actor_near_iterator::valid(const actor* a) const
 void actor_near_iterator::advance()
 {
     do
-         if (++i >= MAX_MONSTERS)
+         if ((i = _next_near_slot(center, _los, i)) >= MAX_MONSTERS)
              return;
     while (!valid(**this));
 }
@@ -72,18 +83,16 @@ void actor_near_iterator::advance()
 //////////////////////////////////////////////////////////////////////////
 
 monster_near_iterator::monster_near_iterator(coord_def c, los_type los)
-    : center(c), _los(los), viewer(nullptr), i(0)
+    : center(c), _los(los), viewer(nullptr), i(-1)
 {
-    if (!valid(&menv[0]))
-        advance();
+    advance();
     begin_point = i;
 }
 
 monster_near_iterator::monster_near_iterator(const actor *a, los_type los)
-    : center(a->pos()), _los(los), viewer(a), i(0)
+    : center(a->pos()), _los(los), viewer(a), i(-1)
 {
-    if (!valid(&menv[0]))
-        advance();
+    advance();
     begin_point = i;
 }
 
@@ -154,7 +163,7 @@ bool monster_near_iterator::valid(const monster* a) const
 void monster_near_iterator::advance()
 {
     do
-         if (++i >= MAX_MONSTERS)
+         if ((i = _next_near_slot(center, _los, i)) >= MAX_MONSTERS)
              return;
     while (!valid(**this));
 }
@@ -162,10 +171,9 @@ void monster_near_iterator::advance()
 //////////////////////////////////////////////////////////////////////////
 
 monster_iterator::monster_iterator()
-    : i(0)
+    : i(-1)
 {
-    while (i < MAX_MONSTERS && !menv[i].alive())
-        i++;
+    advance();
 }
 
 monster_iterator::operator bool() const
@@ -188,9 +196,7 @@ monster* monster_iterator::operator->() const
 
 monster_iterator& monster_iterator::operator++()
 {
-    while (++i < MAX_MONSTERS)
-        if (menv[i].alive())
-            break;
+    advance();
     return *this;
 }
 
@@ -204,7 +210,7 @@ monster_iterator monster_iterator::operator++(int)
 void monster_iterator::advance()
 {
     do
-         if (++i >= MAX_MONSTERS)
+         if ((i = mons_index_next(i)) >= MAX_MONSTERS)
              return;
     while (!(*this)->alive());
 }
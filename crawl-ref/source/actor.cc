@@ -18,6 +18,7 @@
 #include "los.h"
 #include "mon-behv.h"
 #include "mon-death.h"
+#include "mon-util.h"
 #include "religion.h"
 #include "stepdown.h"
 #include "stringutil.h"
@@ -137,6 +138,8 @@ void actor::set_position(const coord_def &c)
 {
     const coord_def oldpos = position;
     position = c;
+    if (is_monster())
+        mons_index_moved(*as_monster());
     los_actor_moved(this, oldpos);
     areas_actor_moved(this, oldpos);
 }
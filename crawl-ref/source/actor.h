@@ -16,7 +16,9 @@
 #include "size-type.h"
 #include "stat-type.h"
 
-#define CLING_KEY "clinging" // 'is creature clinging' property key
+static constexpr store_key CLING_KEY("clinging"); // is creature clinging
+static constexpr store_key SPECTRAL_WEAPON_KEY("spectral_weapon");
+static constexpr store_key TORPOR_SLOWED_KEY("torpor_slowed");
 
 enum ev_ignore_bit
 {
@@ -246,7 +248,6 @@ public:
                        bool temp = true) const = 0;
     int  skill_rdiv(skill_type sk, int mult = 1, int div = 1) const;
 
-#define TORPOR_SLOWED_KEY "torpor_slowed"
     bool torpor_slowed() const;
 
     virtual int heads() const = 0;
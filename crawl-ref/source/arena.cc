@@ -7,7 +7,14 @@
 
 #include "arena.h"
 
+#include <cinttypes>
+#include <chrono>
 #include <stdexcept>
+#ifdef UNIX
+#include <fcntl.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
 
 #include "act-iter.h"
 #include "colour.h"
@@ -31,8 +38,12 @@
 #include "mon-tentacle.h"
 #include "newgame-def.h"
 #include "ng-init.h"
+#include "random.h"
 #include "spl-miscast.h"
+#include "startup.h"
 #include "state.h"
+#include "syscalls.h"
+#include "tags.h"
 #include "stringutil.h"
 #include "teleport.h"
 #include "terrain.h"
@@ -159,6 +170,7 @@ static void _results_popup(string msg, bool error=false)
 namespace arena
 {
     static bool skipped_arena_ui = true; // whether this is an interactive session
+    static bool headless = false; // tournament worker: no display at all
     static void write_error(const string &error);
 
     struct arena_error : public runtime_error
@@ -219,6 +231,7 @@ namespace arena
     static int ties        = 0;
 
     static int turns       = 0;
+    static int max_turns   = 0;
 
     static bool allow_summons       = true;
     static bool allow_animate       = true;
@@ -446,6 +459,7 @@ namespace arena
         respawn         =  strip_tag(spec, "respawn");
         move_respawns   =  strip_tag(spec, "move_respawns");
         summon_throttle = strip_number_tag(spec, "summon_throttle:");
+        max_turns       = max(0, strip_number_tag(spec, "max_turns:"));
 
         if (real_summons && respawn)
         {
@@ -559,6 +573,9 @@ namespace arena
 
     static void show_fight_banner(bool after_fight = false)
     {
+        if (headless)
+            return;
+
         int line = 1;
 
         cgotoxy(1, line++, GOTO_STAT);
@@ -851,13 +868,21 @@ namespace arena
 
     static void do_fight()
     {
-        viewwindow();
+        if (!headless)
+            viewwindow();
         clear_messages(true);
 
+        bool out_of_turns = false;
         {
             cursor_control coff(false);
             while (fight_is_on() && !contest_cancelled)
             {
+                if (max_turns && turns >= max_turns)
+                {
+                    out_of_turns = true;
+                    break;
+                }
+
 #ifdef ARENA_VERBOSE
                 mprf("---- Turn #%d ----", turns);
 #endif
@@ -879,7 +904,8 @@ namespace arena
                 clear_messages();
                 ASSERT(you.pet_target == MHITNOT);
             }
-            viewwindow();
+            if (!headless)
+                viewwindow();
         }
 
         if (contest_cancelled)
@@ -898,7 +924,13 @@ namespace arena
         // ball lightning or ballistomycete spores winning the fight via suicide.
         // The sanity checking is probably just paranoia.
         bool was_tied = false;
-        if (!faction_a.won && !faction_b.won)
+        if (out_of_turns)
+        {
+            mprf("Turn limit of %d reached.", max_turns);
+            ties++;
+            was_tied = true;
+        }
+        else if (!faction_a.won && !faction_b.won)
         {
             if (faction_a.active_members > 0)
             {
@@ -1586,3 +1618,337 @@ NORETURN void run_arena(const newgame_def& choice, const string &default_arena_t
     }
     while (true);
 }
+
+#ifdef UNIX
+namespace arena
+{
+    struct fight_result
+    {
+        int spec;
+        int trial;
+        int winner;      // 0 for team A, 1 for team B, -1 for a tie
+        int turns;
+        int64_t usecs;   // wall time
+        string desc_a, desc_b;
+        string error;    // non-empty if the fight couldn't be run
+    };
+
+    static void marshall_fight(writer &th, const fight_result &fight)
+    {
+        marshallInt(th, fight.spec);
+        marshallInt(th, fight.trial);
+        marshallInt(th, fight.winner);
+        marshallInt(th, fight.turns);
+        marshallSigned(th, fight.usecs);
+        marshallString(th, fight.desc_a);
+        marshallString(th, fight.desc_b);
+        marshallString(th, fight.error);
+    }
+
+    static fight_result unmarshall_fight(reader &th)
+    {
+        fight_result fight;
+        fight.spec   = unmarshallInt(th);
+        fight.trial  = unmarshallInt(th);
+        fight.winner = unmarshallInt(th);
+        fight.turns  = unmarshallInt(th);
+        fight.usecs  = unmarshallSigned(th);
+        fight.desc_a = unmarshallString(th);
+        fight.desc_b = unmarshallString(th);
+        fight.error  = unmarshallString(th);
+        return fight;
+    }
+
+    // Number of rounds requested by a spec's t: tag, as parse_monster_spec()
+    // reads it.
+    static int spec_trials(string spec)
+    {
+        const int ntrials = strip_number_tag(spec, "t:");
+        return ntrials != TAG_UNFOUND && ntrials >= 1 && ntrials <= 99
+               ? ntrials : 1;
+    }
+
+    /// Run round `trial` of `spec` with no display and no messages.
+    static fight_result tournament_fight(const string &spec, int spec_idx,
+                                         int trial)
+    {
+        fight_result fight = { spec_idx, trial, -1, 0, 0, "", "", "" };
+        const auto start = chrono::steady_clock::now();
+        try
+        {
+            global_setup(spec);
+            // Rounds alternate which side is placed first.
+            trials_done = trial;
+            setup_fight();
+            do_fight();
+
+            fight.winner = ties ? -1 : team_a_wins ? 0 : 1;
+            fight.turns  = turns;
+            fight.desc_a = faction_a.desc;
+            fight.desc_b = faction_b.desc;
+        }
+        catch (const arena_error &error)
+        {
+            fight.error = error.what();
+        }
+        catch (const game_ended_condition &ge)
+        {
+            fight.error = ge.message.empty() ? "game ended" : ge.message;
+        }
+        fight.usecs = chrono::duration_cast<chrono::microseconds>(
+                          chrono::steady_clock::now() - start).count();
+        return fight;
+    }
+
+    // Body of a forked worker: run every jobs'th fight, starting with the
+    // job'th, and write each result to `out` with its fight index as it
+    // finishes.
+    NORETURN static void tournament_worker(const vector<string> &specs,
+                                           const vector<pair<int, int>> &fights,
+                                           int job, int jobs,
+                                           uint64_t base_seed, FILE *out)
+    {
+        // Monster actions still redraw the view here and there; give curses
+        // somewhere harmless to draw, and keep it off the controlling tty.
+        const int devnull = open("/dev/null", O_RDWR);
+        if (devnull != -1)
+        {
+            dup2(devnull, STDIN_FILENO);
+            dup2(devnull, STDOUT_FILENO);
+            close(devnull);
+        }
+        cio_init();
+
+        headless = true;
+        crawl_state.disables.set(DIS_DELAY);
+        unwind_bool wiz(you.wizard, true);
+        no_messages mx;
+        init_level_connectivity();
+
+        writer th("arena tournament results", out);
+        for (unsigned int i = job; i < fights.size(); i += jobs)
+        {
+            // Seeded per fight, so results don't depend on the job count.
+            seed_rng(base_seed + i);
+            const pair<int, int> &fight = fights[i];
+            marshallBoolean(th, true);
+            marshallInt(th, i);
+            marshall_fight(th, tournament_fight(specs[fight.first],
+                                                fight.first, fight.second));
+            fflush(out);
+        }
+        marshallBoolean(th, false);
+        fclose(out);
+        // Don't run the parent's exit handlers.
+        _exit(0);
+    }
+
+    static string csv_quote(const string &s)
+    {
+        return "\"" + replace_all(s, "\"", "\"\"") + "\"";
+    }
+
+    static void write_tournament_csv(const vector<string> &specs,
+                                     const vector<fight_result> &results)
+    {
+        FILE *fights = fopen_u("arena-fights.csv", "w");
+        FILE *summary = fopen_u("arena-tournament.csv", "w");
+        if (!fights || !summary)
+            end(1, true, "Can't write arena tournament results");
+
+        fprintf(fights, "spec,round,winner,turns,wall_ms,error\n");
+        for (const fight_result &fight : results)
+        {
+            fprintf(fights, "%s,%d,%s,%d,%.3f,%s\n",
+                    csv_quote(specs[fight.spec]).c_str(), fight.trial + 1,
+                    !fight.error.empty() ? "error"
+                    : fight.winner == 0  ? "A"
+                    : fight.winner == 1  ? "B"
+                                         : "tie",
+                    fight.turns, fight.usecs / 1000.0,
+                    csv_quote(fight.error).c_str());
+        }
+
+        fprintf(summary, "spec,team_a,team_b,fights,a_wins,b_wins,ties,"
+                         "errors,a_win_rate,mean_turns,max_turns,"
+                         "mean_wall_ms,max_wall_ms\n");
+        for (unsigned int s = 0; s < specs.size(); ++s)
+        {
+            string desc_a, desc_b;
+            int count = 0, wins[2] = { 0, 0 }, tied = 0, errors = 0;
+            int64_t sum_turns = 0, longest = 0, sum_usecs = 0, slowest = 0;
+            for (const fight_result &fight : results)
+            {
+                if (fight.spec != (int) s)
+                    continue;
+                count++;
+                if (!fight.error.empty())
+                {
+                    errors++;
+                    continue;
+                }
+                desc_a = fight.desc_a;
+                desc_b = fight.desc_b;
+                if (fight.winner < 0)
+                    tied++;
+                else
+                    wins[fight.winner]++;
+                sum_turns += fight.turns;
+                longest = max<int64_t>(longest, fight.turns);
+                sum_usecs += fight.usecs;
+                slowest = max(slowest, fight.usecs);
+            }
+            const int run = count - errors;
+            fprintf(summary, "%s,%s,%s,%d,%d,%d,%d,%d,%.4f,%.1f,%" PRId64
+                             ",%.3f,%.3f\n",
+                    csv_quote(specs[s]).c_str(), csv_quote(desc_a).c_str(),
+                    csv_quote(desc_b).c_str(), count, wins[0], wins[1], tied,
+                    errors, run ? (double) wins[0] / run : 0.0,
+                    run ? (double) sum_turns / run : 0.0, longest,
+                    run ? sum_usecs / 1000.0 / run : 0.0, slowest / 1000.0);
+        }
+
+        fclose(fights);
+        fclose(summary);
+    }
+}
+#endif
+
+/**
+ * Run every arena spec (one per line) in spec_file, each for as many rounds
+ * as its t: tag asks for, spread over -jobs forked workers with no display.
+ * Per-fight results go to arena-fights.csv and per-spec win rates, turn
+ * counts and wall times to arena-tournament.csv.
+ */
+NORETURN void run_arena_tournament(const string &spec_file)
+{
+#ifndef UNIX
+    UNUSED(spec_file);
+    end(1, false, "Arena tournaments are only supported on Unix.");
+#else
+    FILE *f = fopen_u(spec_file.c_str(), "r");
+    if (!f)
+        end(1, true, "Can't read %s", spec_file.c_str());
+
+    vector<string> specs;
+    vector<pair<int, int>> fights;
+    char line[1024];
+    while (fgets(line, sizeof(line), f))
+    {
+        const string spec = trimmed_string(line);
+        if (spec.empty() || spec[0] == '#')
+            continue;
+        for (int trial = 0, n = arena::spec_trials(spec); trial < n; ++trial)
+            fights.emplace_back(specs.size(), trial);
+        specs.push_back(spec);
+    }
+    fclose(f);
+
+    if (fights.empty())
+        end(1, false, "No arena specs in %s", spec_file.c_str());
+
+    crawl_state.type = GAME_TYPE_ARENA;
+    _init_arena();
+
+    const int jobs = min<int>(SysEnv.jobs, fights.size());
+    // There's no game here to have set you.game_seed, so take -seed (or the
+    // seed option) directly.
+    const uint64_t base_seed = Options.seed ? Options.seed
+                             : Options.seed_from_rc ? Options.seed_from_rc
+                             : get_uint64();
+    printf("Running %d fights from %d specs with %d workers "
+           "(base seed %" PRIu64 ")...\n", (int) fights.size(),
+           (int) specs.size(), jobs, base_seed);
+    fflush(stdout);
+    fflush(stderr);
+
+    // Each worker writes its results to a temporary file of its own rather
+    // than a pipe, so that none of them can block on a full pipe while the
+    // parent is busy with another.
+    vector<pair<pid_t, FILE *>> workers;
+    for (int job = 0; job < jobs; ++job)
+    {
+        FILE *results = tmpfile();
+        if (!results)
+        {
+            perror("tmpfile");
+            break;
+        }
+
+        const pid_t pid = fork();
+        if (pid == -1)
+        {
+            perror("fork");
+            fclose(results);
+            break;
+        }
+
+        if (!pid)
+        {
+            for (const auto &worker : workers)
+                fclose(worker.second);
+            arena::tournament_worker(specs, fights, job, jobs, base_seed,
+                                     results);
+        }
+
+        workers.emplace_back(pid, results);
+    }
+
+    if (workers.empty())
+        end(1, false, "Couldn't start any arena workers.");
+
+    // Anything a worker didn't report (because it died, or was never
+    // started) is recorded as an error.
+    vector<arena::fight_result> results(fights.size());
+    for (unsigned int i = 0; i < fights.size(); ++i)
+    {
+        results[i] = { fights[i].first, fights[i].second, -1, 0, 0, "", "",
+                       "worker died" };
+    }
+
+    // Collect each worker's results once it has exited, and put them in
+    // their place by fight index.
+    for (unsigned int job = 0; job < workers.size(); ++job)
+    {
+        waitpid(workers[job].first, nullptr, 0);
+        FILE *out = workers[job].second;
+        rewind(out);
+        reader th(out);
+        th.set_safe_read(true);
+        try
+        {
+            while (unmarshallBoolean(th))
+            {
+                const unsigned int i = unmarshallInt(th);
+                const arena::fight_result fight = arena::unmarshall_fight(th);
+                if (i < results.size())
+                    results[i] = fight;
+            }
+        }
+        catch (short_read_exception &E)
+        {
+            fprintf(stderr, "Worker %d died without reporting.\n", job + 1);
+        }
+        printf("%d..", job + 1);
+        fflush(stdout);
+        fclose(out);
+    }
+    printf("Finished.\n");
+
+    arena::write_tournament_csv(specs, results);
+
+    int errors = 0;
+    for (const arena::fight_result &fight : results)
+    {
+        if (!fight.error.empty())
+        {
+            errors++;
+            fprintf(stderr, "%s (round %d): %s\n",
+                    specs[fight.spec].c_str(), fight.trial + 1,
+                    fight.error.c_str());
+        }
+    }
+    end(errors ? 1 : 0, false,
+        "Wrote arena-tournament.csv and arena-fights.csv\n");
+#endif
+}
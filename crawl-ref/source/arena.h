@@ -16,6 +16,7 @@ struct coord_def;
 struct newgame_def;
 
 NORETURN void run_arena(const newgame_def& choice, const string &default_arena_teams);
+NORETURN void run_arena_tournament(const string &spec_file);
 
 monster_type arena_pick_random_monster(const level_id &place);
 
@@ -9,24 +9,237 @@
  *
  * Tests will run only with Crawl built in its source tree without
  * DATA_DIR_PATH set.
+ *
+ * The save benchmark (-save-bench) also lives here. Unlike the tests it is
+ * available in every build, since timing a debug build tells us little.
 **/
 
 #include "AppHdr.h"
 
-#ifdef DEBUG_TESTS
-
 #include "ctest.h"
 
+#include <chrono>
+#include <cinttypes>
+#ifdef UNIX
+#include <sys/resource.h>
+#endif
+
+#include "end.h"
+#include "errors.h"
+#include "files.h"
+#include "package.h"
+#include "player.h"
+#include "state.h"
+#include "stringutil.h"
+#include "tags.h"
+
+struct save_bench_stats
+{
+    int chunks = 0;
+    uint64_t read_usecs = 0;
+    uint64_t construct_usecs = 0;
+    uint64_t compress_usecs = 0;
+    uint64_t raw_bytes = 0;
+    uint64_t packed_bytes = 0;
+};
+
+static uint64_t _usecs_since(chrono::steady_clock::time_point start)
+{
+    return chrono::duration_cast<chrono::microseconds>(
+        chrono::steady_clock::now() - start).count();
+}
+
+// Load one tagged chunk into the game state, as _restore_game and
+// load_level would. Returns false if the chunk is from an incompatible
+// version.
+static bool _bench_read_chunk(package &save, const string &name, tag_type tag,
+                              save_bench_stats &stats)
+{
+    const auto start = chrono::steady_clock::now();
+
+    reader inf(&save, name);
+    const save_version version = get_save_version(inf);
+    if (!version.is_compatible())
+        return false;
+    inf.setMinorVersion(version.minor);
+    crawl_state.minor_version = version.minor;
+    tag_read(inf, tag);
+    inf.fail_if_not_eof(name);
+
+    stats.read_usecs += _usecs_since(start);
+    return true;
+}
+
+// Write the chunk back out to the scratch package: first marshalled to
+// memory, then compressed with the codec the original chunk used.
+static void _bench_write_chunk(package &scratch, const string &name,
+                               tag_type tag, chunk_codec codec,
+                               save_bench_stats &stats)
+{
+    auto start = chrono::steady_clock::now();
+    vector<unsigned char> buf;
+    {
+        writer outf(&buf);
+        marshallUByte(outf, TAG_MAJOR_VERSION);
+        marshallUByte(outf, TAG_MINOR_VERSION);
+        tag_write(tag, outf);
+    }
+    stats.construct_usecs += _usecs_since(start);
+
+    // Otherwise the package would notice that nothing changed since the
+    // last iteration and skip the write.
+    if (scratch.has_chunk(name))
+        scratch.delete_chunk(name);
+
+    const plen_t before = scratch.get_bytes_written();
+    start = chrono::steady_clock::now();
+    {
+        writer outf(&scratch, name, codec);
+        outf.write(buf.data(), buf.size());
+    }
+    stats.compress_usecs += _usecs_since(start);
+
+    stats.raw_bytes += buf.size();
+    stats.packed_bytes += scratch.get_bytes_written() - before;
+    stats.chunks++;
+}
+
+static void _bench_save(const string &path, const string &scratch_path,
+                        int iters, save_bench_stats &you_stats,
+                        save_bench_stats &level_stats)
+{
+    package save(path.c_str(), false);
+    if (!restore_char_chunk(&save))
+    {
+        printf("%s: incompatible version, skipped\n", path.c_str());
+        return;
+    }
+
+    vector<pair<string, level_id>> levels;
+    for (const string &name : save.list_chunks())
+    {
+        try
+        {
+            levels.emplace_back(name, level_id::parse_level_id(name));
+        }
+        catch (const bad_level_id &)
+        {
+            // Not a level.
+        }
+    }
+
+    package scratch(scratch_path.c_str(), true, true);
+    uint64_t load_usecs = 0;
+    for (int i = 0; i < iters; ++i)
+    {
+        const uint64_t before = you_stats.read_usecs + level_stats.read_usecs;
+
+        if (!_bench_read_chunk(save, "you", TAG_YOU, you_stats))
+        {
+            printf("%s: incompatible version, skipped\n", path.c_str());
+            break;
+        }
+        _bench_write_chunk(scratch, "you", TAG_YOU,
+                           save.get_chunk_codec("you"), you_stats);
+
+        for (const auto &level : levels)
+        {
+            you.where_are_you = level.second.branch;
+            you.depth = level.second.depth;
+            you.on_current_level = false;
+            if (!_bench_read_chunk(save, level.first, TAG_LEVEL, level_stats))
+                continue;
+            _bench_write_chunk(scratch, level.first, TAG_LEVEL,
+                               save.get_chunk_codec(level.first), level_stats);
+        }
+        scratch.commit();
+
+        load_usecs += you_stats.read_usecs + level_stats.read_usecs - before;
+    }
+    scratch.unlink();
+
+    printf("%s: %u levels, %.2f ms per full load\n", path.c_str(),
+           (unsigned int)levels.size(), load_usecs / 1000.0 / iters);
+}
+
+static void _bench_report(const char *tag, const save_bench_stats &stats)
+{
+    if (!stats.chunks)
+        return;
+    printf("%-6s %7d %10.3f %10.3f %10.3f %10.1f %10.1f %6.2f\n",
+           tag, stats.chunks,
+           stats.read_usecs / 1000.0 / stats.chunks,
+           stats.construct_usecs / 1000.0 / stats.chunks,
+           stats.compress_usecs / 1000.0 / stats.chunks,
+           stats.raw_bytes / 1024.0,
+           stats.packed_bytes / 1024.0,
+           stats.packed_bytes ? (double)stats.raw_bytes / stats.packed_bytes
+                              : 0.0);
+}
+
+/**
+ * Repeatedly load and re-save every chunk of every save in a directory, and
+ * report how long each tag takes to read, construct and compress. Nothing in
+ * the saves themselves is changed; the re-saved chunks go to a scratch
+ * package next to them.
+ */
+void run_save_benchmark()
+{
+    const string &dir = crawl_state.save_bench_dir;
+    const int iters = crawl_state.save_bench_iters;
+    const string scratch_path = catpath(dir, "save-bench.tmp");
+
+    save_bench_stats you_stats, level_stats;
+    int saves = 0;
+    for (const string &file : get_dir_files_sorted(dir))
+    {
+        if (!ends_with(file, SAVE_SUFFIX))
+            continue;
+        try
+        {
+            _bench_save(catpath(dir, file), scratch_path, iters, you_stats,
+                        level_stats);
+            saves++;
+        }
+        catch (const ext_fail_exception &E)
+        {
+            printf("%s: %s\n", file.c_str(), E.what());
+        }
+    }
+
+    printf("\n%d saves, %d iterations; times are ms per chunk\n", saves,
+           iters);
+    printf("%-6s %7s %10s %10s %10s %10s %10s %6s\n", "tag", "chunks",
+           "read", "construct", "compress", "raw KB", "packed KB", "ratio");
+    _bench_report("you", you_stats);
+    _bench_report("level", level_stats);
+
+#ifdef UNIX
+    struct rusage usage;
+    if (!getrusage(RUSAGE_SELF, &usage))
+    {
+#ifdef __APPLE__
+        const long rss_kb = usage.ru_maxrss / 1024;
+#else
+        const long rss_kb = usage.ru_maxrss;
+#endif
+        printf("peak RSS: %ld KB\n", rss_kb);
+    }
+#endif
+
+    end(saves ? 0 : 1, false);
+}
+
+#ifdef DEBUG_TESTS
+
 #include <algorithm>
 #include <vector>
 
 #include "clua.h"
 #include "cluautil.h"
 #include "coordit.h"
+#include "database.h"
 #include "dlua.h"
-#include "end.h"
-#include "errors.h"
-#include "files.h"
 #include "item-name.h"
 #include "jobs.h"
 #include "libutil.h"
@@ -37,8 +250,7 @@
 #include "mon-place.h"
 #include "mon-util.h"
 #include "ng-init.h"
-#include "state.h"
-#include "stringutil.h"
+#include "store.h"
 #include "xom.h"
 
 static const string test_dir = "test";
@@ -189,6 +401,8 @@ void run_tests()
     _run_test("mon-data", debug_mondata);
     _run_test("mon-spell", debug_monspells);
     _run_test("coordit", coordit_tests);
+    _run_test("store", store_tests);
+    _run_test("database", database_tests);
     _run_test("makename", make_name_tests);
     _run_test("job-data", debug_jobdata);
     _run_test("mon-bands", debug_bands);
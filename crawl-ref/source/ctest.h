@@ -3,3 +3,4 @@
 #ifdef DEBUG_TESTS
 NORETURN void run_tests();
 #endif
+NORETURN void run_save_benchmark();
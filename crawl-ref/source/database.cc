@@ -18,12 +18,16 @@
 #include "clua.h"
 #include "end.h"
 #include "files.h"
+#include "hash.h"
+#include "initfile.h"
 #include "libutil.h"
 #include "options.h"
 #include "random.h"
+#include "state.h"
 #include "stringutil.h"
 #include "syscalls.h"
 #include "unicode.h"
+#include "version.h"
 
 // TextDB handles dependency checking the db vs text files, creating the
 // db, loading, and destroying the DB.
@@ -32,11 +36,15 @@ class TextDB
 public:
     // db_name is the savedir-relative name of the db file,
     // minus the "db" extension.
-    TextDB(const char* db_name, const char* dir, vector<string> files);
+    // If indexed, the db also gets a trigram index of its keys and bodies
+    // for the regex searches.
+    TextDB(const char* db_name, const char* dir, vector<string> files,
+           bool indexed = false);
     TextDB(TextDB *parent);
     ~TextDB() { shutdown(true); delete translation; }
     void init();
     void shutdown(bool recursive = false);
+    string file_name();
     DBM* get() { return _db; }
 
     // Make it easier to migrate from raw DBM* to TextDB
@@ -49,9 +57,11 @@ public:
 
  private:
     bool open_db();
+    bool open_prebuilt();
     const char* const _db_name;
     string _directory;
     vector<string> _input_files;
+    bool _indexed;
     DBM* _db;
     string timestamp;
     TextDB *_parent;
@@ -67,6 +77,14 @@ static void _store_text_db(const string &in, DBM *db);
 static string _query_database(TextDB &db, string key, bool canonicalise_key,
                               bool run_lua, bool untranslated = false);
 static void _add_entry(DBM *db, const string &k, string &v);
+#ifdef USE_SQLITE_DBM
+static void _entry_trigrams(const string &key, const string &body,
+                            vector<uint32_t> &terms);
+#endif
+
+// Part of the timestamp of indexed dbs, so that changing the index
+// format regenerates them.
+#define INDEX_FORMAT "trigram1"
 
 static TextDB AllDBs[] =
 {
@@ -84,7 +102,8 @@ static TextDB AllDBs[] =
             "cards.txt",
             "commands.txt",
             "clouds.txt",
-            "status.txt" }),
+            "status.txt" },
+          true),
 
     TextDB("gamestart", "descript/",
           { "species.txt",
@@ -149,20 +168,35 @@ static TextDB& HelpDB        = AllDBs[7];
 static TextDB& FAQDB         = AllDBs[8];
 static TextDB& HintsDB       = AllDBs[9];
 
-static string _db_cache_path(string db, const char *lang)
+// Prebuilt dbs from the -text-db manifest: file name to content hash.
+static map<string, string> prebuilt_dbs;
+
+#define TEXT_DB_MANIFEST "MANIFEST"
+
+static string _db_file_name(string db, const char *lang)
 {
     if (lang)
         db = db + "." + lang;
-    return savedir_versioned_path("db/" + db);
+    return db;
+}
+
+static string _db_cache_path(string db, const char *lang)
+{
+    // -builddb -text-db puts the prebuilt dbs in their own directory.
+    if (crawl_state.build_db && !SysEnv.text_db.empty())
+        return catpath(SysEnv.text_db, _db_file_name(db, lang));
+    return savedir_versioned_path("db/" + _db_file_name(db, lang));
 }
 
 // ----------------------------------------------------------------------
 // TextDB
 // ----------------------------------------------------------------------
 
-TextDB::TextDB(const char* db_name, const char* dir, vector<string> files)
+TextDB::TextDB(const char* db_name, const char* dir, vector<string> files,
+               bool indexed)
     : _db_name(db_name), _directory(dir), _input_files(files),
-      _db(nullptr), timestamp(""), _parent(0), translation(0)
+      _indexed(indexed), _db(nullptr), timestamp(""), _parent(0),
+      translation(0)
 {
 }
 
@@ -170,7 +204,8 @@ TextDB::TextDB(TextDB *parent)
     : _db_name(parent->_db_name),
       _directory(parent->_directory + Options.lang_name + "/"),
       _input_files(parent->_input_files), // FIXME: pointless copy
-      _db(nullptr), timestamp(""), _parent(parent), translation(nullptr)
+      _indexed(parent->_indexed), _db(nullptr), timestamp(""),
+      _parent(parent), translation(nullptr)
 {
 }
 
@@ -191,6 +226,32 @@ bool TextDB::open_db()
     return true;
 }
 
+// Open the db from the -text-db set, if it has one. Those are shared
+// read-only by every game, and only checked against the game version
+// (by _read_text_db_manifest()) instead of the text files' timestamps.
+bool TextDB::open_prebuilt()
+{
+    if (!prebuilt_dbs.count(file_name()))
+        return false;
+
+    const string db_path = catpath(SysEnv.text_db,
+                                   _db_file_name(_db_name, lang()));
+#ifdef USE_SQLITE_DBM
+    _db = dbm_open_shared(db_path.c_str());
+#else
+    _db = dbm_open(db_path.c_str(), O_RDONLY, 0660);
+#endif
+    if (!_db)
+        end(1, true, "Failed to open DB: %s", db_path.c_str());
+
+    return true;
+}
+
+string TextDB::file_name()
+{
+    return _db_file_name(_db_name, lang()) + ".db";
+}
+
 void TextDB::init()
 {
     if (Options.lang_name && !_parent)
@@ -199,6 +260,9 @@ void TextDB::init()
         translation->init();
     }
 
+    if (open_prebuilt())
+        return;
+
     open_db();
 
     if (!_needs_update())
@@ -225,7 +289,7 @@ void TextDB::shutdown(bool recursive)
 
 bool TextDB::_needs_update() const
 {
-    string ts;
+    string ts = _indexed ? INDEX_FORMAT : "";
     bool no_files = true;
 
     for (const string &file : _input_files)
@@ -286,13 +350,24 @@ void TextDB::_regenerate_db()
     }
 
     file_lock lock(db_path + ".lk", "wb");
-#ifndef DGL_REWRITE_PROTECT_DB_FILES
+#ifdef USE_SQLITE_DBM
+    // Build into a temporary file and rename it over the old db once done,
+    // so that games with the old one open (perhaps memory-mapped, for a
+    // -text-db set) never see it half-written.
+    const string build_path = db_path + ".tmp";
+    const string full_build_path = build_path + ".db";
+    unlink_u(full_build_path.c_str());
+#else
+    // Other dbm libraries use several files; rebuild in place.
+    const string build_path = db_path;
+# ifndef DGL_REWRITE_PROTECT_DB_FILES
     unlink_u(full_db_path.c_str());
+# endif
 #endif
 
-    string ts;
-    if (!(_db = dbm_open(db_path.c_str(), O_RDWR | O_CREAT, 0660)))
-        end(1, true, "Unable to open DB: %s", db_path.c_str());
+    string ts = _indexed ? INDEX_FORMAT : "";
+    if (!(_db = dbm_open(build_path.c_str(), O_RDWR | O_CREAT, 0660)))
+        end(1, true, "Unable to open DB: %s", build_path.c_str());
     for (const string &file : _input_files)
     {
         string full_input_path = _directory + file;
@@ -313,9 +388,21 @@ void TextDB::_regenerate_db()
         }
     }
     _add_entry(_db, "TIMESTAMP", ts);
+#ifdef USE_SQLITE_DBM
+    if (_indexed && _db->build_index(_entry_trigrams) != SQLITE_OK)
+        end(1, false, "Unable to index DB: %s", _db->error.c_str());
+#endif
 
     dbm_close(_db);
     _db = 0;
+
+#ifdef USE_SQLITE_DBM
+    if (rename_u(full_build_path.c_str(), full_db_path.c_str()))
+    {
+        unlink_u(full_build_path.c_str());
+        end(1, true, "Unable to replace %s", full_db_path.c_str());
+    }
+#endif
 }
 
 // ----------------------------------------------------------------------
@@ -324,10 +411,147 @@ void TextDB::_regenerate_db()
 
 #define NUM_DB ARRAYSZ(AllDBs)
 
+// Read the manifest of a -text-db directory into dbs, returning the game
+// version the dbs were built by, or an empty string if there is none.
+static string _read_text_db_manifest(map<string, string> &dbs)
+{
+    const string manifest = catpath(SysEnv.text_db, TEXT_DB_MANIFEST);
+    FileLineInput inf(manifest.c_str());
+    if (inf.error())
+        return "";
+
+    string version;
+    while (!inf.eof())
+    {
+        const string line = inf.get_line();
+        if (line.empty() || line[0] == '#')
+            continue;
+
+        const vector<string> fields = split_string(" ", line);
+        if (fields.size() != 2)
+            continue;
+        if (fields[0] == "version")
+            version = fields[1];
+        else
+            dbs[fields[1]] = fields[0];
+    }
+    return version;
+}
+
+static bool _read_file(const string &path, string &contents)
+{
+    FILE *f = fopen_u(path.c_str(), "rb");
+    if (!f)
+        return false;
+
+    char buf[16384];
+    size_t len;
+    while ((len = fread(buf, 1, sizeof(buf), f)) > 0)
+        contents.append(buf, len);
+    fclose(f);
+    return true;
+}
+
+// After -builddb -text-db, list the dbs with the hashes of their contents.
+// Translations built by earlier runs for other languages are kept.
+static void _write_text_db_manifest()
+{
+    map<string, string> dbs;
+    if (_read_text_db_manifest(dbs) != Version::Long)
+        dbs.clear();
+
+    for (unsigned int i = 0; i < NUM_DB; i++)
+    {
+        for (TextDB *db = &AllDBs[i]; db; db = db->translation)
+        {
+            string contents;
+            const string file = db->file_name();
+            if (_read_file(catpath(SysEnv.text_db, file), contents))
+            {
+                dbs[file] = make_stringf("%08x",
+                                         hash32(contents.data(),
+                                                contents.size()));
+            }
+        }
+    }
+
+    const string manifest = catpath(SysEnv.text_db, TEXT_DB_MANIFEST);
+    const string tmpfile = manifest + ".tmp";
+    FILE *f = fopen_replace(tmpfile.c_str());
+    if (!f)
+        end(1, true, "Unable to write %s", tmpfile.c_str());
+    fprintf(f, "# Text databases built by %s -builddb -text-db\n", CRAWL);
+    fprintf(f, "version %s\n", Version::Long);
+    for (const auto &db : dbs)
+        fprintf(f, "%s %s\n", db.second.c_str(), db.first.c_str());
+    if (fclose(f))
+    {
+        unlink_u(tmpfile.c_str());
+        end(1, true, "Unable to write %s", tmpfile.c_str());
+    }
+
+    if (rename_u(tmpfile.c_str(), manifest.c_str()))
+    {
+        unlink_u(tmpfile.c_str());
+        end(1, true, "Unable to replace %s", manifest.c_str());
+    }
+}
+
+// Read the manifest back as games will, and check that it is for this
+// version and that every db it lists is there with the hash it gives.
+static void _check_text_db_manifest()
+{
+    map<string, string> dbs;
+    const string version = _read_text_db_manifest(dbs);
+    if (version != Version::Long)
+    {
+        end(1, false, "The manifest in %s is for version '%s', not %s.",
+            SysEnv.text_db.c_str(), version.c_str(), Version::Long);
+    }
+
+    for (const auto &db : dbs)
+    {
+        string contents;
+        const string path = catpath(SysEnv.text_db, db.first);
+        if (!_read_file(path, contents))
+            end(1, true, "Unable to read %s", path.c_str());
+
+        const string hash = make_stringf("%08x",
+                                         hash32(contents.data(),
+                                                contents.size()));
+        if (hash != db.second)
+        {
+            end(1, false, "%s has hash %s, but the manifest lists %s.",
+                path.c_str(), hash.c_str(), db.second.c_str());
+        }
+    }
+}
+
 void databaseSystemInit()
 {
+    if (!SysEnv.text_db.empty() && !crawl_state.build_db)
+    {
+        const string version = _read_text_db_manifest(prebuilt_dbs);
+        if (version.empty())
+        {
+            end(1, false, "No text databases in %s; build them with "
+                "-builddb -text-db.", SysEnv.text_db.c_str());
+        }
+        if (version != Version::Long)
+        {
+            end(1, false, "The text databases in %s were built by %s, not %s.",
+                SysEnv.text_db.c_str(), version.c_str(), Version::Long);
+        }
+    }
+
     for (unsigned int i = 0; i < NUM_DB; i++)
         AllDBs[i].init();
+
+    if (!SysEnv.text_db.empty() && crawl_state.build_db)
+    {
+        _write_text_db_manifest();
+        _check_text_db_manifest();
+    }
 }
 
 void databaseSystemShutdown()
@@ -356,6 +580,181 @@ static datum _database_fetch(DBM *database, const string &key)
     return result;
 }
 
+#ifdef USE_SQLITE_DBM
+// Index terms are the trigrams of the lowercased ASCII words of an entry,
+// tagged with whether they come from the key or the body. Words never
+// straddle other characters, so a literal word fragment in a pattern can
+// only match entries having all of its trigrams.
+static const uint32_t TRIGRAM_KEY  = 0;
+static const uint32_t TRIGRAM_BODY = 1 << 24;
+
+static bool _is_word_char(char c)
+{
+    return isaalnum(c);
+}
+
+static void _add_word_trigrams(const string &word, uint32_t field,
+                               vector<uint32_t> &terms)
+{
+    for (size_t i = 0; i + 2 < word.length(); ++i)
+    {
+        terms.push_back(field
+                        | (uint8_t) word[i] << 16
+                        | (uint8_t) word[i + 1] << 8
+                        | (uint8_t) word[i + 2]);
+    }
+}
+
+static void _add_text_trigrams(const string &text, uint32_t field,
+                               vector<uint32_t> &terms)
+{
+    string word;
+    for (char c : text)
+    {
+        if (_is_word_char(c))
+            word += toalower(c);
+        else
+        {
+            _add_word_trigrams(word, field, terms);
+            word.clear();
+        }
+    }
+    _add_word_trigrams(word, field, terms);
+}
+
+static void _entry_trigrams(const string &key, const string &body,
+                            vector<uint32_t> &terms)
+{
+    if (key.find("__") != string::npos)
+        return;
+    _add_text_trigrams(key, TRIGRAM_KEY, terms);
+    _add_text_trigrams(body, TRIGRAM_BODY, terms);
+}
+
+// The trigrams of the literal words every match of the regex must
+// contain. Works for both PCRE and POSIX extended patterns by only
+// trusting plain letters and digits outside of groups, and gives up
+// (returning false) on top level alternation and anything fancier.
+static bool _pattern_trigrams(const string &regex, uint32_t field,
+                              vector<uint32_t> &terms)
+{
+    string word;
+    int depth = 0;
+    auto flush = [&]()
+    {
+        if (!depth)
+            _add_word_trigrams(word, field, terms);
+        word.clear();
+    };
+
+    for (size_t i = 0; i < regex.length(); ++i)
+    {
+        const char c = regex[i];
+        if (_is_word_char(c))
+        {
+            word += toalower(c);
+            continue;
+        }
+
+        switch (c)
+        {
+        case '|':
+            if (!depth)
+                return false;
+            break;
+        case '?':
+        case '*':
+            // The preceding character is optional.
+            if (!word.empty())
+                word.erase(word.length() - 1);
+            break;
+        case '{':
+            if (!word.empty())
+                word.erase(word.length() - 1);
+            i = regex.find('}', i);
+            if (i == string::npos)
+                return false;
+            break;
+        case '(':
+            // Inline options could turn on extended mode and comments.
+            if (i + 1 < regex.length() && regex[i + 1] == '?')
+                return false;
+            flush();
+            ++depth;
+            continue;
+        case ')':
+            flush();
+            if (depth)
+                --depth;
+            continue;
+        case '\\':
+            // Allow only the escapes that stand for a single character.
+            if (++i < regex.length() && _is_word_char(regex[i])
+                && !strchr("bBdDsSwWAzZ", regex[i]))
+            {
+                return false;
+            }
+            break;
+        case '[':
+            if (i + 1 < regex.length() && regex[i + 1] == '^')
+                ++i;
+            if (i + 1 < regex.length() && regex[i + 1] == ']')
+                ++i;
+            while (++i < regex.length() && regex[i] != ']')
+            {
+                // Skip escapes, and don't try to parse [:classes:].
+                if (regex[i] == '\\')
+                    ++i;
+                else if (regex[i] == '[')
+                    return false;
+            }
+            if (i >= regex.length())
+                return false;
+            break;
+        default:
+            break;
+        }
+        flush();
+    }
+    flush();
+
+    sort(terms.begin(), terms.end());
+    terms.erase(unique(terms.begin(), terms.end()), terms.end());
+    return !terms.empty();
+}
+#endif
+
+// The keys which may match the regex in the given field: those found by
+// the index if the db has one and the regex has some literal words,
+// otherwise all of them.
+static vector<string> _database_candidates(DBM *database, const string &regex,
+                                           bool body)
+{
+#ifdef USE_SQLITE_DBM
+    vector<uint32_t> terms;
+    if (_pattern_trigrams(regex, body ? TRIGRAM_BODY : TRIGRAM_KEY, terms))
+    {
+        unique_ptr<vector<string>> keys = database->index_lookup(terms);
+        if (keys)
+            return *keys;
+    }
+#else
+    UNUSED(regex);
+    UNUSED(body);
+#endif
+
+    vector<string> keys;
+    datum dbKey = dbm_firstkey(database);
+
+    while (dbKey.dptr != nullptr)
+    {
+        keys.emplace_back((const char *)dbKey.dptr, dbKey.dsize);
+        dbKey = dbm_nextkey(database);
+    }
+
+    return keys;
+}
+
 static vector<string> _database_find_keys(DBM *database,
                                           const string &regex,
                                           bool ignore_case,
@@ -364,20 +763,14 @@ static vector<string> _database_find_keys(DBM *database,
     text_pattern             tpat(regex, ignore_case);
     vector<string> matches;
 
-    datum dbKey = dbm_firstkey(database);
-
-    while (dbKey.dptr != nullptr)
+    for (const string &key : _database_candidates(database, regex, false))
     {
-        string key((const char *)dbKey.dptr, dbKey.dsize);
-
         if (tpat.matches(key)
             && key.find("__") == string::npos
             && (filter == nullptr || !(*filter)(key, "")))
         {
             matches.push_back(key);
         }
-
-        dbKey = dbm_nextkey(database);
     }
 
     return matches;
@@ -391,13 +784,9 @@ static vector<string> _database_find_bodies(DBM *database,
     text_pattern             tpat(regex, ignore_case);
     vector<string> matches;
 
-    datum dbKey = dbm_firstkey(database);
-
-    while (dbKey.dptr != nullptr)
+    for (const string &key : _database_candidates(database, regex, true))
     {
-        string key((const char *)dbKey.dptr, dbKey.dsize);
-
-        datum dbBody = dbm_fetch(database, dbKey);
+        datum dbBody = _database_fetch(database, key);
         string body((const char *)dbBody.dptr, dbBody.dsize);
 
         if (tpat.matches(body)
@@ -406,8 +795,6 @@ static vector<string> _database_find_bodies(DBM *database,
         {
             matches.push_back(key);
         }
-
-        dbKey = dbm_nextkey(database);
     }
 
     return matches;
@@ -911,3 +1298,226 @@ string getHintString(const string &key)
 {
     return unwrap_desc(_query_database(HintsDB, key, true, true));
 }
+
+#ifdef DEBUG_TESTS
+#ifdef USE_SQLITE_DBM
+struct pattern_trigram_test
+{
+    const char *regex;
+    // The words whose trigrams the index should look for, separated by
+    // spaces, or nullptr if the index can't be used for this pattern.
+    const char *words;
+    // Strings the pattern matches; each must have every trigram looked for.
+    vector<string> matches;
+    // Whether the matches only match under PCRE.
+    bool pcre_only;
+};
+
+static string _trigram_names(const vector<uint32_t> &terms)
+{
+    vector<string> names;
+    for (uint32_t t : terms)
+    {
+        names.push_back(make_stringf("%c%c%c", (char) (t >> 16),
+                                     (char) (t >> 8), (char) t));
+    }
+    return comma_separated_line(names.begin(), names.end(), ", ", ", ");
+}
+
+// The keys of every entry of the db, in order.
+static vector<string> _all_keys(SQL_DBM &db)
+{
+    vector<string> keys;
+    for (unique_ptr<string> key = db.firstkey(); key; key = db.nextkey())
+        keys.push_back(*key);
+    sort(keys.begin(), keys.end());
+    return keys;
+}
+
+// Build a small indexed db, and check that index lookups find exactly the
+// entries that a scan of every entry says have all the trigrams; then that
+// a db without an index falls back to scanning.
+static void _index_lookup_tests()
+{
+    string dir = savedir_versioned_path("db");
+    if (!check_mkdir("DB directory", &dir))
+        die("can't create %s", dir.c_str());
+    const string indexed_path = catpath(dir, "index-test");
+    const string plain_path = catpath(dir, "index-test-plain");
+    unlink_u((indexed_path + ".db").c_str());
+    unlink_u((plain_path + ".db").c_str());
+
+    const vector<string> words =
+    {
+        "dragon", "fire", "frost", "golden", "serpent", "scale", "ring",
+        "shadow", "orc", "spear", "crystal",
+    };
+    // Enough entries that some gaps between the rowids of a term take more
+    // than one byte to encode.
+    map<string, string> entries;
+    for (int i = 0; i < 400; ++i)
+    {
+        const string key = make_stringf("%s %d", words[i % 7].c_str(), i);
+        string body = words[i * 3 % 11] + " " + words[i / 40 % 11];
+        if (i % 97 == 5)
+            body += " xyzzy";
+        entries[key] = body;
+    }
+    entries["__reserved"] = "dragon fire";
+
+    {
+        SQL_DBM indexed(indexed_path, false, true);
+        SQL_DBM plain(plain_path, false, true);
+        for (const auto &entry : entries)
+        {
+            if (indexed.insert(entry.first, entry.second) != SQLITE_DONE
+                || plain.insert(entry.first, entry.second) != SQLITE_DONE)
+            {
+                die("can't fill the index test dbs: %s%s",
+                    indexed.error.c_str(), plain.error.c_str());
+            }
+        }
+        if (indexed.build_index(_entry_trigrams) != SQLITE_OK)
+            die("can't index the test db: %s", indexed.error.c_str());
+    }
+
+    SQL_DBM indexed(indexed_path, true, true);
+    SQL_DBM plain(plain_path, true, true);
+    const vector<string> all_keys = _all_keys(plain);
+    if (_all_keys(indexed) != all_keys || all_keys.size() != entries.size())
+        die("index test dbs don't have every entry");
+
+    const vector<pair<string, bool>> patterns =
+    {
+        { "dragon", false }, { "fire", true }, { "golden.*serpent", true },
+        { "xyzzy", true }, { "crystal orc", true }, { "scale", false },
+        { "qqqq", true },
+    };
+    for (const auto &pattern : patterns)
+    {
+        const string &regex = pattern.first;
+        const bool body = pattern.second;
+        vector<uint32_t> terms;
+        if (!_pattern_trigrams(regex, body ? TRIGRAM_BODY : TRIGRAM_KEY,
+                               terms))
+        {
+            die("/%s/ doesn't use the index", regex.c_str());
+        }
+
+        vector<string> expected;
+        for (const string &key : all_keys)
+        {
+            vector<uint32_t> have;
+            _entry_trigrams(key, plain.query(key), have);
+            sort(have.begin(), have.end());
+            if (includes(have.begin(), have.end(), terms.begin(), terms.end()))
+                expected.push_back(key);
+        }
+
+        unique_ptr<vector<string>> found = indexed.index_lookup(terms);
+        if (!found)
+            die("/%s/: no index lookup: %s", regex.c_str(),
+                indexed.error.c_str());
+        if (*found != expected)
+        {
+            die("/%s/: the index found %u entries, not the %u a scan finds",
+                regex.c_str(), (unsigned int) found->size(),
+                (unsigned int) expected.size());
+        }
+
+        if (plain.index_lookup(terms))
+            die("/%s/: index lookup in a db without one", regex.c_str());
+        if (_database_candidates(&plain, regex, body) != all_keys)
+            die("/%s/: no fallback to a scan without an index", regex.c_str());
+    }
+
+    indexed.close();
+    plain.close();
+    unlink_u((indexed_path + ".db").c_str());
+    unlink_u((plain_path + ".db").c_str());
+}
+#endif
+
+// Check _pattern_trigrams() on each kind of regex it has to handle: the
+// trigrams it picks must be exactly those of the expected words, and every
+// string matching the regex must have all of them, or index lookups would
+// miss real matches. Then check the lookups themselves.
+void database_tests()
+{
+#ifdef USE_SQLITE_DBM
+    const vector<pattern_trigram_test> tests =
+    {
+        // Optional and repeated characters.
+        { "colou?r", "colo", { "color", "colour", "two colours" } },
+        { "abcd*efg", "abc efg", { "abcefg", "abcddefg" } },
+        { "abcd{1,2}ef", "abc", { "abcdef", "abcddef" } },
+        { "a{2}b", nullptr, { "aab" } },
+        // Groups, with and without alternation inside.
+        { "(x|y)abc", "abc", { "xabc", "yabc" } },
+        { "abc(de|fg)hij", "abc hij", { "abcdehij", "abcfghij" } },
+        { "abc(def)?ghi", "abc ghi", { "abcghi", "abcdefghi" } },
+        // Bracket expressions.
+        { "[^]a]bcd", "bcd", { "xbcd", "zbcd" } },
+        { "abc[de]fgh", "abc fgh", { "abcdfgh", "abcefgh" } },
+        { "[[:alpha:]]abc", nullptr, { "xabc" } },
+        // Escapes: class escapes split words, anything else gives up.
+        { "abc\\dxyz", "abc xyz", { "abc5xyz" }, true },
+        { "abc\\.def", "abc def", { "abc.def" } },
+        { "abc\\x41", nullptr, { "abcA" }, true },
+        { "abc\\Qdef", nullptr, { "abcdef" }, true },
+        // Inline options and top level alternation.
+        { "(?i)abcd", nullptr, { "ABCD" }, true },
+        { "abcd|efgh", nullptr, { "abcd", "efgh" } },
+        { "(abcd|efgh)ijk", "ijk", { "abcdijk", "efghijk" } },
+    };
+
+    for (const auto &test : tests)
+    {
+        vector<uint32_t> terms;
+        const bool indexed = _pattern_trigrams(test.regex, TRIGRAM_BODY,
+                                               terms);
+        if (indexed != !!test.words)
+        {
+            die("trigrams of /%s/: %s the index", test.regex,
+                indexed ? "used" : "didn't use");
+        }
+        if (!indexed)
+            continue;
+
+        vector<uint32_t> expected;
+        _add_text_trigrams(test.words, TRIGRAM_BODY, expected);
+        sort(expected.begin(), expected.end());
+        expected.erase(unique(expected.begin(), expected.end()),
+                       expected.end());
+        if (terms != expected)
+        {
+            die("trigrams of /%s/: got %s, expected %s", test.regex,
+                _trigram_names(terms).c_str(),
+                _trigram_names(expected).c_str());
+        }
+
+        for (const string &match : test.matches)
+        {
+#ifndef REGEX_PCRE
+            if (test.pcre_only)
+                continue;
+#endif
+            if (!text_pattern(test.regex, true).matches(match))
+                die("/%s/ doesn't match '%s'", test.regex, match.c_str());
+
+            vector<uint32_t> have;
+            _add_text_trigrams(match, TRIGRAM_BODY, have);
+            sort(have.begin(), have.end());
+            if (!includes(have.begin(), have.end(),
+                          terms.begin(), terms.end()))
+            {
+                die("trigrams of /%s/: %s not all in '%s'", test.regex,
+                    _trigram_names(terms).c_str(), match.c_str());
+            }
+        }
+    }
+
+    _index_lookup_tests();
+#endif
+}
+#endif
@@ -27,6 +27,10 @@ extern "C" {
 void databaseSystemInit();
 void databaseSystemShutdown();
 
+#ifdef DEBUG_TESTS
+void database_tests();
+#endif
+
 typedef bool (*db_find_filter)(string key, string body);
 
 string getQuoteString(const string &key);
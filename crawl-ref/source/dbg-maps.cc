@@ -7,6 +7,12 @@
 
 #include "dbg-maps.h"
 
+#include <cinttypes>
+#ifdef UNIX
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
 #include "branch.h"
 #include "chardump.h"
 #include "crash.h"
@@ -19,9 +25,11 @@
 #include "message.h"
 #include "ng-init.h"
 #include "player.h"
+#include "random.h"
 #include "shopping.h"
 #include "state.h"
 #include "stringutil.h"
+#include "tags.h"
 #include "view.h"
 
 #ifdef DEBUG_STATISTICS
@@ -229,26 +237,13 @@ static bool _build_dungeon()
     return true;
 }
 
-/**
- * Build dungeon levels for mapstat or objstat.
- *
- * The exact branches/levels built and number of build iterations is set by the
- * command-line options for mapstat/objstat.
-
- * @returns True if all iterations built successfully. For mapstat, this can
- * return false if an iteration produced a disconnected level, since for
- * diagnostic purposes we record the map in detail to a file and exit. For
- * objstat, this only returns false if the primary dungeon generation function
- * builder() fails, as the level may be in an invalid state and any object
- * statistics erroneous.
-*/
-bool mapstat_build_levels()
+// Build iterations [first, last). With reseed, each iteration gets its own
+// seed derived from base_seed, so that the outcome doesn't depend on which
+// worker process ran it.
+static bool _build_iterations(int first, int last, bool progress,
+                              bool reseed, uint64_t base_seed)
 {
-    if (!generated_levels.size())
-        _dungeon_places();
-    printf("Iteration: ");
-    fflush(stdout);
-    for (int i = 0; i < SysEnv.map_gen_iters; ++i)
+    for (int i = first; i < last; ++i)
     {
         clear_messages();
         mprf("On %d of %d; %d g, %d fail, %u err%s, %u uniq, "
@@ -258,8 +253,13 @@ bool mapstat_build_levels()
              last_error.empty() ? "" : (" (" + last_error + ")").c_str(),
              (unsigned int)use_count.size(), build_attempts, level_vetoes,
              build_attempts ? level_vetoes * 100.0 / build_attempts : 0.0);
-        printf("%d..", i + 1);
-        fflush(stdout);
+        if (progress)
+        {
+            printf("%d..", i + 1);
+            fflush(stdout);
+        }
+        if (reseed)
+            seed_rng(base_seed + i);
         dlua.callfn("dgn_clear_data", "");
         you.uniq_map_tags.clear();
         you.uniq_map_names.clear();
@@ -271,9 +271,262 @@ bool mapstat_build_levels()
         if (crawl_state.obj_stat_gen)
             objstat_iteration_stats();
     }
+    return true;
+}
+
+#ifdef UNIX
+static void _marshall_counts(writer &th, const map<string, int> &counts)
+{
+    marshallInt(th, counts.size());
+    for (const auto &entry : counts)
+    {
+        marshallString(th, entry.first);
+        marshallInt(th, entry.second);
+    }
+}
+
+static void _merge_counts(reader &th, map<string, int> &counts)
+{
+    for (int n = unmarshallInt(th); n > 0; --n)
+    {
+        const string key = unmarshallString(th);
+        counts[key] += unmarshallInt(th);
+    }
+}
+
+// Send everything _write_map_stats() reports from a worker to the parent.
+static void _marshall_map_stats(writer &th)
+{
+    marshallInt(th, levels_tried);
+    marshallInt(th, levels_failed);
+    marshallInt(th, build_attempts);
+    marshallInt(th, level_vetoes);
+    marshallString(th, last_error);
+
+    _marshall_counts(th, try_count);
+    _marshall_counts(th, use_count);
+    _marshall_counts(th, success_count);
+    _marshall_counts(th, veto_messages);
+
+    marshallInt(th, level_mapcounts.size());
+    for (const auto &entry : level_mapcounts)
+    {
+        marshall_level_id(th, entry.first);
+        marshallInt(th, entry.second);
+    }
+
+    marshallInt(th, map_builds.size());
+    for (const auto &entry : map_builds)
+    {
+        marshall_level_id(th, entry.first);
+        marshallInt(th, entry.second.first);
+        marshallInt(th, entry.second.second);
+    }
+
+    marshallInt(th, level_mapsused.size());
+    for (const auto &entry : level_mapsused)
+    {
+        marshall_level_id(th, entry.first);
+        marshallInt(th, entry.second.size());
+        for (const string &name : entry.second)
+            marshallString(th, name);
+    }
+
+    marshallInt(th, map_levelsused.size());
+    for (const auto &entry : map_levelsused)
+    {
+        marshallString(th, entry.first);
+        marshallInt(th, entry.second.size());
+        for (const level_id &lid : entry.second)
+            marshall_level_id(th, lid);
+    }
+
+    marshallInt(th, errors.size());
+    for (const auto &entry : errors)
+    {
+        marshallString(th, entry.first);
+        marshallString(th, entry.second);
+    }
+}
+
+static void _merge_map_stats(reader &th)
+{
+    levels_tried   += unmarshallInt(th);
+    levels_failed  += unmarshallInt(th);
+    build_attempts += unmarshallInt(th);
+    level_vetoes   += unmarshallInt(th);
+    const string error = unmarshallString(th);
+    if (!error.empty())
+        last_error = error;
+
+    _merge_counts(th, try_count);
+    _merge_counts(th, use_count);
+    _merge_counts(th, success_count);
+    _merge_counts(th, veto_messages);
+
+    for (int n = unmarshallInt(th); n > 0; --n)
+    {
+        const level_id lid = unmarshall_level_id(th);
+        level_mapcounts[lid] += unmarshallInt(th);
+    }
+
+    for (int n = unmarshallInt(th); n > 0; --n)
+    {
+        const level_id lid = unmarshall_level_id(th);
+        map_builds[lid].first += unmarshallInt(th);
+        map_builds[lid].second += unmarshallInt(th);
+    }
+
+    for (int n = unmarshallInt(th); n > 0; --n)
+    {
+        set<string> &maps = level_mapsused[unmarshall_level_id(th)];
+        for (int m = unmarshallInt(th); m > 0; --m)
+            maps.insert(unmarshallString(th));
+    }
+
+    for (int n = unmarshallInt(th); n > 0; --n)
+    {
+        set<level_id> &levels = map_levelsused[unmarshallString(th)];
+        for (int m = unmarshallInt(th); m > 0; --m)
+            levels.insert(unmarshall_level_id(th));
+    }
+
+    for (int n = unmarshallInt(th); n > 0; --n)
+    {
+        const string name = unmarshallString(th);
+        errors[name] = unmarshallString(th);
+    }
+}
+
+struct stat_worker
+{
+    pid_t pid;
+    FILE *results;
+};
+
+/**
+ * Split the iterations between SysEnv.jobs forked workers. Each
+ * builds a contiguous range of iterations and pipes its counters back,
+ * and the parent merges them in worker order. Every iteration is seeded
+ * from a base seed, so the merged stats for a given -seed and -jobs are
+ * reproducible.
+ */
+static bool _build_levels_parallel()
+{
+    const int iters = SysEnv.map_gen_iters;
+    const int jobs = min(SysEnv.jobs, iters);
+    const uint64_t base_seed = you.game_seed ? you.game_seed : get_uint64();
+
+    printf("Building with %d workers (base seed %" PRIu64 ")...\n", jobs,
+           base_seed);
+    fflush(stdout);
+    fflush(stderr);
+
+    vector<stat_worker> workers;
+    for (int job = 0; job < jobs; ++job)
+    {
+        int fds[2];
+        if (pipe(fds))
+        {
+            perror("pipe");
+            break;
+        }
+
+        const pid_t pid = fork();
+        if (pid == -1)
+        {
+            perror("fork");
+            close(fds[0]);
+            close(fds[1]);
+            break;
+        }
+
+        if (!pid)
+        {
+            close(fds[0]);
+            for (const stat_worker &worker : workers)
+                fclose(worker.results);
+
+            const bool ok = _build_iterations(iters * job / jobs,
+                                              iters * (job + 1) / jobs,
+                                              false, true, base_seed);
+
+            FILE *results = fdopen(fds[1], "wb");
+            {
+                writer th("mapstat worker results", results);
+                marshallBoolean(th, ok);
+                _marshall_map_stats(th);
+                if (crawl_state.obj_stat_gen)
+                    objstat_marshall(th);
+            }
+            fclose(results);
+            // Don't run the parent's exit handlers.
+            _exit(0);
+        }
+
+        close(fds[1]);
+        workers.push_back({pid, fdopen(fds[0], "rb")});
+    }
+
+    bool ok = (int)workers.size() == jobs;
+    for (unsigned int job = 0; job < workers.size(); ++job)
+    {
+        reader th(workers[job].results);
+        th.set_safe_read(true);
+        try
+        {
+            ok = unmarshallBoolean(th) && ok;
+            _merge_map_stats(th);
+            if (crawl_state.obj_stat_gen)
+                objstat_merge(th);
+            printf("%d..", job + 1);
+        }
+        catch (short_read_exception &E)
+        {
+            fprintf(stderr, "\nWorker %d died without reporting.\n", job + 1);
+            ok = false;
+        }
+        fflush(stdout);
+        fclose(workers[job].results);
+        waitpid(workers[job].pid, nullptr, 0);
+    }
     printf("Finished.\n");
     fflush(stdout);
-    return true;
+    return ok;
+}
+#endif
+
+/**
+ * Build dungeon levels for mapstat or objstat.
+ *
+ * The exact branches/levels built and number of build iterations is set by the
+ * command-line options for mapstat/objstat. With -jobs, the iterations are
+ * spread over several worker processes.
+
+ * @returns True if all iterations built successfully. For mapstat, this can
+ * return false if an iteration produced a disconnected level, since for
+ * diagnostic purposes we record the map in detail to a file and exit. For
+ * objstat, this only returns false if the primary dungeon generation function
+ * builder() fails, as the level may be in an invalid state and any object
+ * statistics erroneous.
+*/
+bool mapstat_build_levels()
+{
+    if (!generated_levels.size())
+        _dungeon_places();
+#ifdef UNIX
+    if (SysEnv.jobs > 1)
+        return _build_levels_parallel();
+#endif
+    printf("Iteration: ");
+    fflush(stdout);
+    const bool ok = _build_iterations(0, SysEnv.map_gen_iters, true, false, 0);
+    if (ok)
+    {
+        printf("Finished.\n");
+        fflush(stdout);
+    }
+    return ok;
 }
 
 void mapstat_report_map_try(const map_def &map)
@@ -34,6 +34,7 @@
 #include "state.h"
 #include "stepdown.h"
 #include "stringutil.h"
+#include "tags.h"
 #include "version.h"
 
 #ifdef DEBUG_STATISTICS
@@ -918,6 +919,149 @@ void objstat_iteration_stats()
     }
 }
 
+// Marshalling of the tables for parallel mapstat/objstat runs: each worker
+// process sends its tables to the parent, which merges them into its own.
+// Both sides start from the same _init_stats() layout.
+
+static void _marshall_stat_key(writer &th, const level_id &lev)
+{
+    // Not marshall_level_id(), which can't pack the summary levels.
+    marshallInt(th, lev.branch);
+    marshallInt(th, lev.depth);
+}
+
+static void _marshall_stat_key(writer &th, int key)
+{
+    marshallInt(th, key);
+}
+
+static void _unmarshall_stat_key(reader &th, level_id &lev)
+{
+    lev.branch = static_cast<branch_type>(unmarshallInt(th));
+    lev.depth = unmarshallInt(th);
+}
+
+static void _unmarshall_stat_key(reader &th, int &key)
+{
+    key = unmarshallInt(th);
+}
+
+static void _unmarshall_stat_key(reader &th, dungeon_feature_type &key)
+{
+    key = static_cast<dungeon_feature_type>(unmarshallInt(th));
+}
+
+static void _marshall_stat(writer &th, int value)
+{
+    marshallInt(th, value);
+}
+
+static void _marshall_stat(writer &th, const map<string, double> &stats)
+{
+    marshallInt(th, stats.size());
+    for (const auto &entry : stats)
+    {
+        marshallString(th, entry.first);
+        // The worker is a fork of this very process, so the raw double is
+        // safe to send, and keeps the sums exact.
+        th.write(&entry.second, sizeof(entry.second));
+    }
+}
+
+template<typename T>
+static void _marshall_stat(writer &th, const vector<T> &stats);
+template<typename K, typename T>
+static void _marshall_stat(writer &th, const map<K, T> &stats);
+
+template<typename T>
+static void _marshall_stat(writer &th, const vector<T> &stats)
+{
+    marshallInt(th, stats.size());
+    for (const T &entry : stats)
+        _marshall_stat(th, entry);
+}
+
+template<typename K, typename T>
+static void _marshall_stat(writer &th, const map<K, T> &stats)
+{
+    marshallInt(th, stats.size());
+    for (const auto &entry : stats)
+    {
+        _marshall_stat_key(th, entry.first);
+        _marshall_stat(th, entry.second);
+    }
+}
+
+static void _merge_stat(reader &th, int &value)
+{
+    value += unmarshallInt(th);
+}
+
+// Min and max fields combine as such; everything else, including the sums
+// of squares behind the standard deviations, just adds up.
+static void _merge_stat(reader &th, map<string, double> &stats)
+{
+    for (int count = unmarshallInt(th); count > 0; --count)
+    {
+        const string field = unmarshallString(th);
+        double value;
+        th.read(&value, sizeof(value));
+
+        double &stat = stats[field];
+        if (ends_with(field, "Min"))
+            stat = min(stat, value);
+        else if (ends_with(field, "Max"))
+            stat = max(stat, value);
+        else
+            stat += value;
+    }
+}
+
+template<typename T>
+static void _merge_stat(reader &th, vector<T> &stats);
+template<typename K, typename T>
+static void _merge_stat(reader &th, map<K, T> &stats);
+
+template<typename T>
+static void _merge_stat(reader &th, vector<T> &stats)
+{
+    const int count = unmarshallInt(th);
+    ASSERT(count == (int)stats.size());
+    for (T &entry : stats)
+        _merge_stat(th, entry);
+}
+
+template<typename K, typename T>
+static void _merge_stat(reader &th, map<K, T> &stats)
+{
+    for (int count = unmarshallInt(th); count > 0; --count)
+    {
+        K key;
+        _unmarshall_stat_key(th, key);
+        _merge_stat(th, stats[key]);
+    }
+}
+
+void objstat_marshall(writer &th)
+{
+    _marshall_stat(th, item_recs);
+    _marshall_stat(th, weapon_brands);
+    _marshall_stat(th, armour_brands);
+    _marshall_stat(th, missile_brands);
+    _marshall_stat(th, monster_recs);
+    _marshall_stat(th, feature_recs);
+}
+
+void objstat_merge(reader &th)
+{
+    _merge_stat(th, item_recs);
+    _merge_stat(th, weapon_brands);
+    _merge_stat(th, armour_brands);
+    _merge_stat(th, missile_brands);
+    _merge_stat(th, monster_recs);
+    _merge_stat(th, feature_recs);
+}
+
 static void _write_stat_headers(const vector<string> &fields, string desc)
 {
     fprintf(stat_outf, "%s\tLevel", desc.c_str());
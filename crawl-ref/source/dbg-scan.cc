@@ -333,6 +333,13 @@ void debug_mons_scan()
                               m->type, pos.x, pos.y, i);
         }
 
+        if (!mons_index_valid(*m))
+        {
+            mprf(MSGCH_ERROR, "Monster %s at (%d, %d) missing from the "
+                              "monster index, midx = %d",
+                 m->full_name(DESC_PLAIN).c_str(), pos.x, pos.y, i);
+        }
+
         if (!in_bounds(pos))
         {
             mprf(MSGCH_ERROR, "Out of bounds monster: %s at (%d, %d), "
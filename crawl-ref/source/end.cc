@@ -24,11 +24,13 @@
 #include "invent.h"
 #include "item-prop.h"
 #include "los.h"
+#include "losglobal.h"
 #include "macro.h"
 #include "message.h"
 #include "misc.h"
 #include "prompt.h"
 #include "religion.h"
+#include "shout.h"
 #include "startup.h"
 #include "state.h"
 #include "stringutil.h"
@@ -202,6 +204,12 @@ NORETURN void end(int exit_code, bool print_error, const char *format, ...)
 #ifdef DEBUG_PROPS
         dump_prop_accesses();
 #endif
+#ifdef DEBUG_NOISE_PROFILING
+        noise_profile_out();
+#endif
+#ifdef DEBUG_LOS_PROFILING
+        globallos_profile_out();
+#endif
 
         if (!error.empty())
         {
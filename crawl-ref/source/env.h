@@ -18,6 +18,11 @@ typedef vector<unique_ptr<vault_placement>> vault_placement_refv;
 
 typedef FixedArray< map_cell, GXM, GYM > MapKnowledge;
 
+// Size in cells of the squares monsters are bucketed into by position.
+#define MONS_BUCKET_SIZE 8
+#define MONS_BUCKETS_X ((GXM + MONS_BUCKET_SIZE - 1) / MONS_BUCKET_SIZE)
+#define MONS_BUCKETS_Y ((GYM + MONS_BUCKET_SIZE - 1) / MONS_BUCKET_SIZE)
+
 class final_effect;
 struct crawl_environment
 {
@@ -117,6 +122,14 @@ struct crawl_environment
     // Mapping mid->mindex until the transition is finished.
     map<mid_t, unsigned short> mid_cache;
 
+    // Indices of the occupied menv slots in increasing order, and the same
+    // slots by bucket of position (with the bucket each slot is filed
+    // under), so iterating over monsters doesn't need to look at every
+    // slot. Maintained by the mons_index_*() functions in mon-util.cc.
+    vector<int> mons_slots;
+    FixedArray<vector<int>, MONS_BUCKETS_X, MONS_BUCKETS_Y> mons_buckets;
+    FixedVector<coord_def, MAX_MONSTERS> mons_bucket_of;
+
     // Things to happen when the current attack/etc finishes.
     vector<final_effect *> final_effects;
 
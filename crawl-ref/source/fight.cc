@@ -180,7 +180,7 @@ bool fight_melee(actor *attacker, actor *defender, bool *did_hit, bool simu)
             *did_hit = attk.did_hit;
 
         // A spectral weapon attacks whenever the player does
-        if (!simu && you.props.exists("spectral_weapon"))
+        if (!simu && you.props.exists(SPECTRAL_WEAPON_KEY))
             trigger_spectral_weapon(&you, defender);
 
         return true;
@@ -322,7 +322,7 @@ bool fight_melee(actor *attacker, actor *defender, bool *did_hit, bool simu)
     }
 
     // A spectral weapon attacks whenever the player does
-    if (!simu && attacker->props.exists("spectral_weapon"))
+    if (!simu && attacker->props.exists(SPECTRAL_WEAPON_KEY))
         trigger_spectral_weapon(attacker, defender);
 
     return true;
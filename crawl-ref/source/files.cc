@@ -10,6 +10,7 @@
 #include <algorithm>
 #include <cctype>
 #include <cerrno>
+#include <cinttypes>
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
@@ -28,6 +29,8 @@
 #include "abyss.h"
 #include "act-iter.h"
 #include "areas.h"
+#include "art-enum.h"
+#include "artefact.h"
 #include "branch.h"
 #include "chardump.h"
 #include "cloud.h"
@@ -115,6 +118,7 @@ static void _ghost_dprf(const char *format, ...)
 #endif
 
 static void _save_level(const level_id& lid);
+static void _load_level(const level_id &level);
 
 static bool _ghost_version_compatible(const save_version &version);
 
@@ -721,6 +725,200 @@ static void _fill_player_doll(player_save_info &p, package *save)
 }
 #endif
 
+// The save index caches the player_save_info of every save in a save
+// directory, so that listing saves at startup doesn't have to open and
+// decompress each of them. Entries are keyed by the save's size and
+// modification time; a stale or missing entry just means reading that save
+// the old way, and a damaged or outdated index is ignored entirely.
+#ifndef DISABLE_SAVEGAME_LISTS
+#define SAVE_INDEX_FILENAME "saves.idx"
+static const int SAVE_INDEX_MAGIC = 0x53494458;
+
+struct save_index_entry
+{
+    int64_t mtime;
+    int64_t size;
+    player_save_info info;
+};
+
+typedef map<string, save_index_entry> save_index;
+
+static bool _save_file_stamp(const string &path, save_index_entry &entry)
+{
+    struct stat filestat;
+    if (stat(path.c_str(), &filestat))
+        return false;
+
+    entry.mtime = filestat.st_mtime;
+    entry.size = filestat.st_size;
+    return true;
+}
+
+static string _save_index_path(const string &dir)
+{
+    return canonicalise_file_separator(catpath(dir, SAVE_INDEX_FILENAME));
+}
+
+static void _marshall_save_info(writer &outf, const player_save_info &p)
+{
+    marshallString(outf, p.name);
+    marshallInt(outf, p.experience);
+    marshallByte(outf, p.experience_level);
+    marshallBoolean(outf, p.wizard);
+    marshallShort(outf, p.species);
+    marshallString(outf, p.species_name);
+    marshallString(outf, p.class_name);
+    marshallShort(outf, p.religion);
+    marshallString(outf, p.god_name);
+    marshallString(outf, p.jiyva_second_name);
+    marshallByte(outf, p.saved_game_type);
+    marshallBoolean(outf, p.save_loadable);
+#ifdef USE_TILE
+    for (int i = 0; i < TILEP_PART_MAX; ++i)
+        marshallUnsigned(outf, p.doll.parts[i]);
+#endif
+}
+
+static void _unmarshall_save_info(reader &inf, player_save_info &p)
+{
+    p.name              = unmarshallString(inf);
+    p.experience        = unmarshallInt(inf);
+    p.experience_level  = unmarshallByte(inf);
+    p.wizard            = unmarshallBoolean(inf);
+    p.species           = static_cast<species_type>(unmarshallShort(inf));
+    p.species_name      = unmarshallString(inf);
+    p.class_name        = unmarshallString(inf);
+    p.religion          = static_cast<god_type>(unmarshallShort(inf));
+    p.god_name          = unmarshallString(inf);
+    p.jiyva_second_name = unmarshallString(inf);
+    p.saved_game_type   = static_cast<game_type>(unmarshallByte(inf));
+    p.save_loadable     = unmarshallBoolean(inf);
+#ifdef USE_TILE
+    for (int i = 0; i < TILEP_PART_MAX; ++i)
+        unmarshallUnsigned(inf, p.doll.parts[i]);
+#endif
+}
+
+#ifdef USE_TILE
+static const bool SAVE_INDEX_HAS_DOLLS = true;
+#else
+static const bool SAVE_INDEX_HAS_DOLLS = false;
+#endif
+
+// The caller is responsible for locking the index.
+static save_index _read_save_index(const string &dir)
+{
+    save_index index;
+
+    FILE *f = fopen_u(_save_index_path(dir).c_str(), "rb");
+    if (!f)
+        return index;
+
+    try
+    {
+        reader inf(f);
+        inf.set_safe_read(true);
+
+        // Enum values and doll tiles can change between versions and
+        // builds, so only trust an index written by this exact binary.
+        if (unmarshallInt(inf) == SAVE_INDEX_MAGIC
+            && unmarshallString(inf) == Version::Long
+            && unmarshallBoolean(inf) == SAVE_INDEX_HAS_DOLLS)
+        {
+            for (int count = unmarshallInt(inf); count > 0; --count)
+            {
+                const string filename = unmarshallString(inf);
+                save_index_entry &entry = index[filename];
+                entry.mtime = unmarshallSigned(inf);
+                entry.size = unmarshallSigned(inf);
+                _unmarshall_save_info(inf, entry.info);
+                entry.info.filename = filename;
+            }
+        }
+    }
+    catch (short_read_exception &E)
+    {
+        dprf("Save index in %s is truncated, ignoring it.", dir.c_str());
+        index.clear();
+    }
+
+    fclose(f);
+    return index;
+}
+
+// The caller is responsible for locking the index. The index is written to
+// a temporary file and renamed into place, so that a crash or a full disk
+// never leaves a half-written index behind.
+static void _write_save_index(const string &dir, const save_index &index)
+{
+    const string path = _save_index_path(dir);
+    const string tmppath = path + ".tmp";
+    FILE *f = fopen_replace(tmppath.c_str());
+    if (!f)
+        return;
+
+    {
+        writer outf(tmppath, f, true);
+        marshallInt(outf, SAVE_INDEX_MAGIC);
+        marshallString(outf, Version::Long);
+        marshallBoolean(outf, SAVE_INDEX_HAS_DOLLS);
+        marshallInt(outf, index.size());
+        for (const auto &entry : index)
+        {
+            marshallString(outf, entry.first);
+            marshallSigned(outf, entry.second.mtime);
+            marshallSigned(outf, entry.second.size);
+            _marshall_save_info(outf, entry.second.info);
+        }
+    }
+
+    if (fclose(f) || rename_u(tmppath.c_str(), path.c_str()))
+        unlink_u(tmppath.c_str());
+}
+#endif // !DISABLE_SAVEGAME_LISTS
+
+// Records the player's save in the index when they leave the game, so that
+// the next start menu can list it without opening it. Only call this once
+// you.save has been closed, as the entry is keyed on the save's final size
+// and modification time.
+static void _update_save_index(const player_save_info &p)
+{
+    if (Options.no_save)
+        return;
+
+#ifndef DISABLE_SAVEGAME_LISTS
+    string dir = _get_savefile_directory();
+    if (dir.empty())
+        dir = ".";
+
+    save_index_entry entry;
+    if (!_save_file_stamp(_get_savedir_path(p.filename), entry))
+        return;
+    entry.info = p;
+
+    file_lock lock(_save_index_path(dir) + ".lk", "wb", false);
+    save_index index = _read_save_index(dir);
+    index[p.filename] = entry;
+    _write_save_index(dir, index);
+#else
+    UNUSED(p);
+#endif
+}
+
+// The index entry for the current player, taken from you.save.
+static player_save_info _current_save_info()
+{
+    player_save_info p;
+    p = you;
+    p.save_loadable = true;
+    p.filename = get_save_filename(you.your_name);
+#ifdef USE_TILE
+    if (you.save->has_chunk("tdl"))
+        _fill_player_doll(p, you.save);
+#endif
+    return p;
+}
+
 /*
  * Returns a list of the names of characters that are already saved for the
  * current user.
@@ -739,10 +937,33 @@ static vector<player_save_info> _find_saved_characters()
     if (searchpath.empty())
         searchpath = ".";
 
+    save_index old_index;
+    {
+        file_lock lock(_save_index_path(searchpath) + ".lk", "rb", false);
+        old_index = _read_save_index(searchpath);
+    }
+
+    save_index index;
+    int stale = 0;
+
     for (const string &filename : get_dir_files_sorted(searchpath))
     {
         if (is_save_file_name(filename))
         {
+            save_index_entry entry;
+            if (!_save_file_stamp(_get_savedir_path(filename), entry))
+                continue;
+
+            const save_index_entry *cached = map_find(old_index, filename);
+            if (cached && cached->mtime == entry.mtime
+                && cached->size == entry.size)
+            {
+                index[filename] = *cached;
+                chars.push_back(cached->info);
+                continue;
+            }
+
+            stale++;
             try
             {
                 package save(_get_savedir_path(filename).c_str(), false);
@@ -751,9 +972,13 @@ static vector<player_save_info> _find_saved_characters()
                 {
                     p.filename = filename;
 #ifdef USE_TILE
-                    if (Options.tile_menu_icons && save.has_chunk("tdl"))
+                    // Always fill the doll, as the index is shared with
+                    // runs where tile_menu_icons might be set.
+                    if (save.has_chunk("tdl"))
                         _fill_player_doll(p, &save);
 #endif
+                    entry.info = p;
+                    index[filename] = entry;
                     chars.push_back(p);
                 }
             }
@@ -769,6 +994,16 @@ static vector<player_save_info> _find_saved_characters()
         }
     }
 
+    dprf("Save index for %s: %u saves, %d read from disk.",
+         searchpath.c_str(), (unsigned int)chars.size(), stale);
+
+    // Also rewrite the index when saves have disappeared.
+    if (stale || index.size() != old_index.size())
+    {
+        file_lock lock(_save_index_path(searchpath) + ".lk", "wb", false);
+        _write_save_index(searchpath, index);
+    }
+
     sort(chars.begin(), chars.end());
 #endif // !DISABLE_SAVEGAME_LISTS
     return chars;
@@ -849,9 +1084,10 @@ void write_ghost_version(writer &outf)
         marshallInt(outf, 0);
 }
 
-static void _write_tagged_chunk(const string &chunkname, tag_type tag)
+static void _write_tagged_chunk(const string &chunkname, tag_type tag,
+                                chunk_codec codec)
 {
-    writer outf(you.save, chunkname);
+    writer outf(you.save, chunkname, codec);
 
     // write version
     marshallUByte(outf, TAG_MAJOR_VERSION);
@@ -1361,6 +1597,9 @@ bool generate_level(const level_id &l)
     _generic_level_reset();
     delete_all_clouds();
     los_changed(); // invalidate the los cache, which impacts monster placement
+    // Likewise the area grid: whether the builder has to recompute it, which
+    // can use the RNG, must not depend on the level that was there before.
+    invalidate_agrid(true);
 
     // initialize env for builder
     env.turns_on_level = -1;
@@ -1387,6 +1626,363 @@ bool generate_level(const level_id &l)
     return true;
 }
 
+// Background pregeneration keeps its progress and its own copy of the
+// levelgen state in this prop.
+static const string PREGEN_KEY = "pregen_background";
+
+/**
+ * The levels built by dungeon pregeneration, in the order they are built.
+ * Levels are always generated in this order, whether they are built all at
+ * once when the game starts or in the background while it is being played,
+ * so that a seed builds the same dungeon as far as the game allows.
+ */
+vector<level_id> pregen_level_order()
+{
+    // bel's original proposal generated D to lair depth, then lair, then D
+    // to orc depth, then orc, then the rest of D. I have simplified this to
+    // just generate whole branches at a time -- I am not sure how much real
+    // impact this has. One idea might be to shuffle this slightly based on
+    // the seed.
+    // TODO: probably need to do portal vaults too?
+    // Should this use something like logical_branch_order?
+    static const vector<branch_type> generation_order =
+    {
+        BRANCH_DUNGEON,
+        BRANCH_TEMPLE,
+        BRANCH_LAIR,
+        BRANCH_ORC,
+        BRANCH_SPIDER,
+        BRANCH_SNAKE,
+        BRANCH_SHOALS,
+        BRANCH_SWAMP,
+        BRANCH_VAULTS,
+        BRANCH_CRYPT,
+        BRANCH_DEPTHS,
+        BRANCH_VESTIBULE,
+        BRANCH_ELF,
+        BRANCH_ZOT,
+        BRANCH_SLIME,
+        BRANCH_TOMB,
+        BRANCH_TARTARUS,
+        BRANCH_COCYTUS,
+        BRANCH_DIS,
+        BRANCH_GEHENNA,
+    };
+
+    vector<level_id> levels;
+    // TODO: why is dungeon invalid? it's not set up properly in
+    // `initialise_branch_depths` for some reason. The vestibule is invalid
+    // because its depth isn't set until the player actually enters a portal.
+    for (auto br : generation_order)
+    {
+        if (!brentry[br].is_valid()
+            && br != BRANCH_DUNGEON && br != BRANCH_VESTIBULE)
+        {
+            continue;
+        }
+        for (int i = 1; i <= branches[br].numlevels; i++)
+            levels.emplace_back(br, i);
+    }
+    return levels;
+}
+
+/**
+ * The parts of the player's state that dungeon generation reads and updates,
+ * besides the level being built: which uniques, unrandarts and unique vaults
+ * have already been placed.
+ */
+struct levelgen_state
+{
+    FixedBitVector<NUM_MONSTERS> unique_creatures;
+    FixedVector<unique_item_status_type, MAX_UNRANDARTS> unique_items;
+    uint8_t octopus_king_rings;
+    set<string> uniq_map_tags;
+    set<string> uniq_map_names;
+
+    static levelgen_state from_player();
+    void to_player() const;
+    void save(CrawlHashTable &table) const;
+    void load(const CrawlHashTable &table);
+};
+
+levelgen_state levelgen_state::from_player()
+{
+    levelgen_state state;
+    state.unique_creatures = you.unique_creatures;
+    state.unique_items = you.unique_items;
+    state.octopus_king_rings = you.octopus_king_rings;
+    state.uniq_map_tags = you.uniq_map_tags;
+    state.uniq_map_names = you.uniq_map_names;
+    return state;
+}
+
+void levelgen_state::to_player() const
+{
+    you.unique_creatures = unique_creatures;
+    you.unique_items = unique_items;
+    you.octopus_king_rings = octopus_king_rings;
+    you.uniq_map_tags = uniq_map_tags;
+    you.uniq_map_names = uniq_map_names;
+}
+
+void levelgen_state::save(CrawlHashTable &table) const
+{
+    // new_vector() would add to the vectors of an earlier save.
+    for (const char *key : { "uniques", "unrands", "map_tags", "map_names" })
+        table.erase(key);
+
+    CrawlVector &uniques = table["uniques"].new_vector(SV_INT);
+    for (int i = 0; i < NUM_MONSTERS; i++)
+        if (unique_creatures[i])
+            uniques.push_back(i);
+
+    CrawlVector &unrands = table["unrands"].new_vector(SV_INT);
+    for (int i = 0; i < MAX_UNRANDARTS; i++)
+        unrands.push_back(static_cast<int>(unique_items[i]));
+
+    table["octopus_king_rings"] = static_cast<int>(octopus_king_rings);
+
+    CrawlVector &tags = table["map_tags"].new_vector(SV_STR);
+    for (const string &tag : uniq_map_tags)
+        tags.push_back(tag);
+
+    CrawlVector &names = table["map_names"].new_vector(SV_STR);
+    for (const string &name : uniq_map_names)
+        names.push_back(name);
+}
+
+void levelgen_state::load(const CrawlHashTable &table)
+{
+    unique_creatures.reset();
+    for (const CrawlStoreValue &mons : table["uniques"].get_vector())
+        unique_creatures.set(mons.get_int());
+
+    const CrawlVector &unrands = table["unrands"].get_vector();
+    for (int i = 0; i < MAX_UNRANDARTS; i++)
+    {
+        unique_items[i] = i < (int) unrands.size()
+            ? static_cast<unique_item_status_type>(unrands[i].get_int())
+            : UNIQ_NOT_EXISTS;
+    }
+
+    octopus_king_rings = table["octopus_king_rings"].get_int();
+
+    uniq_map_tags.clear();
+    for (const CrawlStoreValue &tag : table["map_tags"].get_vector())
+        uniq_map_tags.insert(tag.get_string());
+
+    uniq_map_names.clear();
+    for (const CrawlStoreValue &name : table["map_names"].get_vector())
+        uniq_map_names.insert(name.get_string());
+}
+
+/**
+ * Start pregenerating the dungeon in the background: instead of building
+ * every level up front, one more level is built with pregen_background_step()
+ * each time the player changes level, and any levels still missing are built
+ * (in order) as soon as the player tries to enter one of them.
+ *
+ * So that the levels come out as full pregeneration would have built them,
+ * the builder never sees what happens in play: it works on a copy of the
+ * levelgen state taken now, which only the levels it builds update.
+ */
+void pregen_background_start()
+{
+    CrawlHashTable &pregen = you.props[PREGEN_KEY].get_table();
+    pregen["next"] = 0;
+    pregen["elapsed_time"] = you.elapsed_time;
+    levelgen_state::from_player().save(pregen);
+}
+
+bool pregen_background_pending()
+{
+    return you.props.exists(PREGEN_KEY);
+}
+
+// Find the next level that background pregeneration still has to build.
+static bool _pregen_background_next(level_id &next)
+{
+    if (!pregen_background_pending())
+        return false;
+
+    const vector<level_id> order = pregen_level_order();
+    int &idx = you.props[PREGEN_KEY].get_table()["next"].get_int();
+    while (idx < (int) order.size() && is_existing_level(order[idx]))
+        idx++;
+
+    if (idx >= (int) order.size())
+    {
+        dprf("Background pregeneration finished.");
+        you.props.erase(PREGEN_KEY);
+        return false;
+    }
+
+    next = order[idx];
+    return true;
+}
+
+/**
+ * Remove from the level just built the uniques and unrandarts that it placed
+ * but that the game had already placed elsewhere. That only happens when
+ * play got to them before the pregeneration did.
+ *
+ * @param before The pregeneration's levelgen state before the level was built.
+ * @param after  The pregeneration's levelgen state after it.
+ * @param game   The levelgen state of the game.
+ * @return whether anything was removed.
+ */
+static bool _pregen_remove_duplicates(const levelgen_state &before,
+                                      const levelgen_state &after,
+                                      const levelgen_state &game)
+{
+    bool removed = false;
+    for (monster_iterator mi; mi; ++mi)
+    {
+        if (mons_is_unique(mi->type)
+            && after.unique_creatures[mi->type]
+            && !before.unique_creatures[mi->type]
+            && game.unique_creatures[mi->type])
+        {
+            dprf("Removing duplicate %s", mi->name(DESC_PLAIN, true).c_str());
+            mi->destroy_inventory();
+            monster_cleanup(*mi);
+            removed = true;
+        }
+    }
+
+    for (int i = 0; i < MAX_ITEMS; i++)
+    {
+        item_def &item = mitm[i];
+        if (!item.defined() || !is_unrandom_artefact(item))
+            continue;
+
+        const int idx = item.unrand_idx - UNRAND_START;
+        if (after.unique_items[idx] != UNIQ_NOT_EXISTS
+            && before.unique_items[idx] == UNIQ_NOT_EXISTS
+            && game.unique_items[idx] != UNIQ_NOT_EXISTS)
+        {
+            dprf("Removing duplicate %s", item.name(DESC_PLAIN).c_str());
+            destroy_item(i);
+            removed = true;
+        }
+    }
+    return removed;
+}
+
+/**
+ * Build a level of the background pregeneration, as full pregeneration would
+ * have built it at the start of the game, and save it. Then let the game know
+ * about the uniques, unrandarts and unique vaults it placed.
+ *
+ * The caller must be between levels, as for generate_level().
+ */
+static void _pregen_background_generate(const level_id &lid)
+{
+    CrawlHashTable &pregen = you.props[PREGEN_KEY].get_table();
+    const levelgen_state game = levelgen_state::from_player();
+    levelgen_state before;
+    before.load(pregen);
+
+    {
+        // be sure that AK start doesn't interfere with the builder
+        unwind_var<game_chapter> chapter(you.chapter, CHAPTER_ORB_HUNTING);
+        // Keep the player's targeting, which the level reset would otherwise
+        // lose.
+        unwind_var<unsigned short> prev_targ(you.prev_targ);
+        unwind_var<coord_def> prev_grd_targ(you.prev_grd_targ);
+        // Date the level from the start of the game, as full pregeneration
+        // would have.
+        unwind_var<int> elapsed(you.elapsed_time,
+                                pregen["elapsed_time"].get_int());
+        unwind_bool on_level(you.on_current_level, true);
+        no_messages mx;
+
+        dprf("Pregenerating %s in the background", lid.describe().c_str());
+        before.to_player();
+        generate_level(lid);
+        pregen["next"].get_int()++;
+        // Also when the level is saved again from off the level.
+        env.elapsed_time = you.elapsed_time;
+
+        const levelgen_state after = levelgen_state::from_player();
+        after.save(pregen);
+
+        unwind_var<int> depth(you.depth, lid.depth);
+        unwind_var<branch_type> branch(you.where_are_you, lid.branch);
+        if (_pregen_remove_duplicates(before, after, game))
+            _save_level(lid);
+    }
+
+    // Add what the level placed to the game's state.
+    const levelgen_state after = levelgen_state::from_player();
+    levelgen_state merged = game;
+    for (int i = 0; i < NUM_MONSTERS; i++)
+        if (after.unique_creatures[i] && !before.unique_creatures[i])
+            merged.unique_creatures.set(i);
+    for (int i = 0; i < MAX_UNRANDARTS; i++)
+    {
+        if (before.unique_items[i] == UNIQ_NOT_EXISTS
+            && merged.unique_items[i] == UNIQ_NOT_EXISTS)
+        {
+            merged.unique_items[i] = after.unique_items[i];
+        }
+    }
+    merged.octopus_king_rings |= after.octopus_king_rings;
+    merged.uniq_map_tags.insert(after.uniq_map_tags.begin(),
+                                after.uniq_map_tags.end());
+    merged.uniq_map_names.insert(after.uniq_map_names.begin(),
+                                 after.uniq_map_names.end());
+    merged.to_player();
+}
+
+/**
+ * Build every level that background pregeneration would have built before
+ * `target`, and `target` itself, so that the levels are generated in the same
+ * order as if the whole dungeon had been pregenerated. Does nothing if
+ * `target` is not part of the pregenerated dungeon.
+ *
+ * The caller must be between levels, as for generate_level().
+ */
+static void _pregen_background_catch_up(const level_id &target)
+{
+    if (!pregen_background_pending() || is_existing_level(target))
+        return;
+
+    const vector<level_id> order = pregen_level_order();
+    if (find(order.begin(), order.end(), target) == order.end())
+        return;
+
+    level_id next;
+    while (!is_existing_level(target) && _pregen_background_next(next))
+        _pregen_background_generate(next);
+}
+
+/**
+ * Build the next level of a background pregeneration, on a level excursion
+ * from the current level. Called once the player has changed level, since
+ * the game pauses then anyway.
+ */
+void pregen_background_step()
+{
+    if (!pregen_background_pending()
+        || !you.on_current_level
+        || crawl_state.generating_level
+        || !is_connected_branch(level_id::current()))
+    {
+        return;
+    }
+
+    level_id next;
+    if (!_pregen_background_next(next))
+        return;
+
+    // The level doesn't exist yet, so this only saves the current level and
+    // leaves it; the excursion reloads it afterwards.
+    level_excursion le;
+    le.go_to(next);
+    _pregen_background_generate(next);
+}
+
 /**
  * Load the current level.
  *
@@ -1482,6 +2078,9 @@ bool load_level(dungeon_feature_type stair_taken, load_mode_type load_mode,
         you.chapter = CHAPTER_ORB_HUNTING;
     }
 
+    if (load_mode != LOAD_VISITOR)
+        _pregen_background_catch_up(level_id::current());
+
     // GENERATE new level when the file can't be opened:
     if (!you.save->has_chunk(level_name))
     {
@@ -1718,14 +2317,29 @@ bool load_level(dungeon_feature_type stair_taken, load_mode_type load_mode,
     return just_created_level;
 }
 
+// Levels written since the game was loaded; _recompress_cold_levels() leaves
+// these alone, since they are the ones likely to be rewritten again soon.
+static set<string> _levels_saved_this_session;
+
+// Called when a game is started or loaded, so that levels from an earlier
+// game in the same process don't count as written this session.
+void start_save_session()
+{
+    _levels_saved_this_session.clear();
+}
+
+// Levels, including pregenerated ones, are saved with fast compression, since
+// the current level is rewritten on every save; _recompress_cold_levels()
+// recompresses them once they have gone unvisited for a session.
 static void _save_level(const level_id& lid)
 {
+    _levels_saved_this_session.insert(lid.describe());
     travel_cache.get_level_info(lid).update();
 
     // Nail all items to the ground.
     fix_item_coordinates();
 
-    _write_tagged_chunk(lid.describe(), TAG_LEVEL);
+    _write_tagged_chunk(lid.describe(), TAG_LEVEL, CODEC_ZLIB_FAST);
 }
 
 #if TAG_MAJOR_VERSION == 34
@@ -1775,8 +2389,8 @@ static void _save_game_base()
     SAVEFILE("tdl", "tiles_doll", save_doll_file);
 #endif
 
-    _write_tagged_chunk("you", TAG_YOU);
-    _write_tagged_chunk("chr", TAG_CHR);
+    _write_tagged_chunk("you", TAG_YOU, CODEC_ZLIB_FAST);
+    _write_tagged_chunk("chr", TAG_CHR, CODEC_ZLIB_FAST);
     
     // Save the level as well; not doing this was causing problems
     // with SIGHUP and acquirement scumming.
@@ -1784,6 +2398,37 @@ static void _save_game_base()
         _save_level(level_id::current());
 }
 
+// At most this many levels are recompressed per save, to keep exiting quick
+// after a session that wrote a lot of them (e.g. background pregeneration).
+static const int RECOMPRESS_LEVELS_PER_EXIT = 4;
+
+/**
+ * Recompress a few of the levels that were saved with fast compression in an
+ * earlier session, and so are unlikely to be rewritten soon. Levels written
+ * in this session are left for a later exit, as are any beyond
+ * RECOMPRESS_LEVELS_PER_EXIT.
+ */
+static void _recompress_cold_levels()
+{
+    int budget = RECOMPRESS_LEVELS_PER_EXIT;
+    for (const string &chunk : you.save->list_chunks())
+    {
+        if (budget <= 0)
+            break;
+        if (chunk == "you" || chunk == "chr"
+            || _levels_saved_this_session.count(chunk)
+            || you.save->get_chunk_codec(chunk) != CODEC_ZLIB_FAST)
+        {
+            continue;
+        }
+        you.save->recompress_chunk(chunk, CODEC_ZLIB_BEST);
+        budget--;
+    }
+
+    // Whatever was written this session is cold once the game is reloaded.
+    _levels_saved_this_session.clear();
+}
+
 // Stack allocated string's go in separate function, so Valgrind doesn't
 // complain.
 static void _save_game_exit()
@@ -1798,6 +2443,10 @@ static void _save_game_exit()
     if (!you.entering_level)
         _save_level(level_id::current());
 
+    _recompress_cold_levels();
+
+    const player_save_info index_info = _current_save_info();
+
     clrscr();
 
 #ifdef DGL_WHEREIS
@@ -1809,6 +2458,8 @@ static void _save_game_exit()
 
     delete you.save;
     you.save = 0;
+
+    _update_save_index(index_info);
 }
 
 void save_game(bool leave_game, const char *farewellmsg)
@@ -1838,7 +2489,16 @@ void save_game(bool leave_game, const char *farewellmsg)
     if (!leave_game)
     {
         if (!crawl_state.disables[DIS_SAVE_CHECKPOINTS])
+        {
             you.save->commit();
+            dprf("Save committed: %u bytes written, %d chunks unchanged so far.",
+                 you.save->get_last_commit_bytes(),
+                 you.save->get_chunks_skipped());
+            // The index isn't updated here: every checkpoint changes the
+            // save's stamp, and a stale entry only means that a start menu
+            // reads this one save directly until the game is saved and
+            // exited.
+        }
         return;
     }
 
@@ -2488,6 +3148,14 @@ static bool _restore_game(const string& filename)
         load_messages(inf);
     }
 
+#ifdef DEBUG_DIAGNOSTICS
+    const package_read_stats &stats = you.save->get_read_stats();
+    dprf("Restored %" PRIu64 " chunks (%" PRIu64 "/%" PRIu64 " bytes) in "
+         "%" PRIu64 "us with %" PRIu64 " syscalls%s.",
+         stats.chunks, stats.bytes_in, stats.bytes_out, stats.usecs,
+         stats.syscalls, you.save->is_mapped() ? ", mapped" : "");
+#endif
+
     return true;
 }
 
@@ -2690,6 +3358,13 @@ static bool _read_char_chunk(package *save)
     };
 }
 
+// Read a save's character info into you; used by the save benchmark, which
+// doesn't go through the usual restore path.
+bool restore_char_chunk(package *save)
+{
+    return _read_char_chunk(save);
+}
+
 static bool _tagged_chunk_version_compatible(reader &inf, string* reason)
 {
     ASSERT(reason);
@@ -82,16 +82,22 @@ class level_id;
 void trackers_init_new_level(bool transit);
 
 bool generate_level(const level_id &l);
+vector<level_id> pregen_level_order();
+void pregen_background_start();
+bool pregen_background_pending();
+void pregen_background_step();
 bool load_level(dungeon_feature_type stair_taken, load_mode_type load_mode,
                 const level_id& old_level);
 void delete_level(const level_id &level);
 
+void start_save_session();
 void save_game(bool leave_game, const char *bye = nullptr);
 
 // Save game without exiting (used when changing levels).
 void save_game_state();
 
 save_version get_save_version(reader &file);
+bool restore_char_chunk(package *save);
 
 bool save_exists(const string& filename);
 bool restore_game(const string& filename);
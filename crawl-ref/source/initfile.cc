@@ -302,6 +302,7 @@ const vector<GameOption*> game_options::build_options_list()
         new StringGameOption(SIMPLE_NAME(sound_file_path), ""),
 #ifndef DGAMELAUNCH
         new BoolGameOption(SIMPLE_NAME(pregen_dungeon), false),
+        new BoolGameOption(SIMPLE_NAME(pregen_background), false),
 #endif
 
 #ifdef DGL_SIMPLE_MESSAGING
@@ -3904,6 +3905,12 @@ enum commandline_option_type
     CLO_PLAYABLE_JSON, // JSON metadata for species, jobs, combos.
     CLO_EDIT_BONES,
     CLO_ADVENTURE,
+    CLO_SAVE_BENCH,
+    CLO_JOBS,
+    CLO_ARENA_TOURNAMENT,
+    CLO_FSIM,
+    CLO_VAULT_DB,
+    CLO_TEXT_DB,
 #ifdef USE_TILE_WEB
     CLO_WEBTILES_SOCKET,
     CLO_AWAIT_CONNECTION,
@@ -3922,7 +3929,8 @@ static const char *cmd_ops[] =
     "extra-opt-first", "extra-opt-last", "sprint-map", "edit-save",
     "print-charset", "tutorial", "wizard", "explore", "no-save", "gdb",
     "no-gdb", "nogdb", "throttle", "no-throttle", "playable-json",
-    "bones", "adventure",
+    "bones", "adventure", "save-bench", "jobs",
+    "arena-tournament", "fsim", "vault-db", "text-db",
 #ifdef USE_TILE_WEB
     "webtiles-socket", "await-connection", "print-webtiles-options",
 #endif
@@ -4175,7 +4183,7 @@ static void _edit_save(int argc, char **argv)
             plen_t frag = save.get_chunk_fragmentation("");
             plen_t flen = save.get_size();
             plen_t slack = save.get_slack();
-            printf("Chunks: (size compressed/uncompressed, fragments, name)\n");
+            printf("Chunks: (size compressed/uncompressed, fragments, codec, name)\n");
             for (const string &chunk : list)
             {
                 int cfrag = save.get_chunk_fragmentation(chunk);
@@ -4187,13 +4195,20 @@ static void _edit_save(int argc, char **argv)
                 plen_t clen = 0;
                 while (plen_t s = in.read(buf, sizeof(buf)))
                     clen += s;
-                printf("%7d/%7d %3u %s\n", cclen, clen, cfrag, chunk.c_str());
+                static const char *codec_names[] = { "zlib", "fast", "best" };
+                COMPILE_CHECK(ARRAYSZ(codec_names) == NUM_CODECS);
+                printf("%7d/%7d %3u %-4s %s\n", cclen, clen, cfrag,
+                       codec_names[save.get_chunk_codec(chunk)], chunk.c_str());
             }
             // the directory is not a chunk visible from the outside
             printf("Fragmentation:    %u/%u (%4.2f)\n", frag, nchunks + 1,
                    ((float)frag) / (nchunks + 1));
             printf("Unused space:     %u/%u (%u%%)\n", slack, flen,
                    100 - (100 * (flen - slack) / flen));
+            const package_read_stats &stats = save.get_read_stats();
+            printf("Read time:        %" PRIu64 "us, %" PRIu64 " syscalls%s\n",
+                   stats.usecs, stats.syscalls,
+                   save.is_mapped() ? " (mapped)" : "");
             // there's also wasted space due to fragmentation, but since
             // it's linear, there's no need to print it
         }
@@ -4624,6 +4639,9 @@ bool parse_args(int argc, char **argv, bool rc_only)
 
     SysEnv.rcdirs.clear();
     SysEnv.map_gen_iters = 0;
+    SysEnv.jobs = 1;
+    SysEnv.vault_db = false;
+    SysEnv.text_db.clear();
 
     if (argc < 2)           // no args!
         return true;
@@ -4801,6 +4819,16 @@ bool parse_args(int argc, char **argv, bool rc_only)
 #endif
             break;
 
+        case CLO_JOBS:
+            if (!next_is_param || !isadigit(*next_arg))
+                end(1, false, "Integer argument required for -%s\n", arg);
+            else
+            {
+                SysEnv.jobs = max(1, min(atoi(next_arg), 256));
+                nextUsed = true;
+            }
+            break;
+
         case CLO_FORCE_MAP:
 #ifdef DEBUG_STATISTICS
             if (!next_is_param)
@@ -4829,6 +4857,33 @@ bool parse_args(int argc, char **argv, bool rc_only)
             }
             break;
 
+        case CLO_ARENA_TOURNAMENT:
+            if (!next_is_param)
+                end(1, false, "-arena-tournament requires a file of arena specs");
+            if (!rc_only)
+                crawl_state.arena_tournament_file = next_arg;
+            nextUsed = true;
+            break;
+
+        case CLO_FSIM:
+#ifdef WIZARD
+            if (!next_is_param)
+                end(1, false, "-fsim requires a species and background");
+            if (!rc_only)
+                crawl_state.fsim_combo = next_arg;
+            nextUsed = true;
+            // Optional "double" for a two-skill sweep.
+            if (current + 2 < argc && !strcmp(argv[current + 2], "double"))
+            {
+                if (!rc_only)
+                    crawl_state.fsim_double_scale = true;
+                current++;
+            }
+#else
+            end(1, false, "Fight simulation requires a build with wizard mode");
+#endif
+            break;
+
         case CLO_DUMP_MAPS:
             crawl_state.dump_maps = true;
             break;
@@ -4865,6 +4920,19 @@ bool parse_args(int argc, char **argv, bool rc_only)
             }
             break;
 
+        case CLO_SAVE_BENCH:
+            if (!next_is_param)
+                end(1, false, "-save-bench requires a directory of saves");
+            crawl_state.save_bench_dir = next_arg;
+            nextUsed = true;
+            // Optional pass count.
+            if (current + 2 < argc && isadigit(*argv[current + 2]))
+            {
+                crawl_state.save_bench_iters = max(1, atoi(argv[current + 2]));
+                current++;
+            }
+            break;
+
         case CLO_BUILDDB:
             if (next_is_param)
                 return false;
@@ -4874,6 +4942,19 @@ bool parse_args(int argc, char **argv, bool rc_only)
 #endif
             break;
 
+        case CLO_VAULT_DB:
+            if (next_is_param)
+                return false;
+            SysEnv.vault_db = true;
+            break;
+
+        case CLO_TEXT_DB:
+            if (!next_is_param)
+                return false;
+            SysEnv.text_db = next_arg;
+            nextUsed = true;
+            break;
+
         case CLO_GDB:
             crawl_state.no_gdb = 0;
             break;
@@ -58,6 +58,9 @@ public:
     vector<string> cmd_args;
 
     int map_gen_iters;
+    int jobs;
+    bool vault_db;                 // Load maps from the packed vault database.
+    string text_db;                // Directory of prebuilt text databases.
     unique_ptr<depth_ranges> map_gen_range;
 
     vector<string> extra_opts_first;
@@ -7,6 +7,7 @@
 
 #include "cluautil.h"
 #include "coord.h"
+#include "los-def.h"
 #include "losglobal.h"
 #include "los.h"
 #include "ray.h"
@@ -57,11 +58,22 @@ LUAFN(los_cell_see_cell)
     PLUARET(number, cell_see_cell(p, q, LOS_DEFAULT));
 }
 
+// Like cell_see_cell, but bypasses the global LOS cache.
+LUAFN(los_cell_see_cell_uncached)
+{
+    COORDS(p, 1, 2);
+    COORDS(q, 3, 4);
+    los_def los(p, opc_default);
+    los.update();
+    PLUARET(boolean, los.see_cell(q));
+}
+
 const struct luaL_reg los_dlib[] =
 {
     { "findray", los_find_ray },
     { "make_ray", los_make_ray },
     { "cell_see_cell", los_cell_see_cell },
+    { "cell_see_cell_uncached", los_cell_see_cell_uncached },
     { nullptr, nullptr }
 };
 
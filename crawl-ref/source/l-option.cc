@@ -10,8 +10,8 @@
  * clear_messages, blink_brightens_background, bold_brightens_foreground,
  * best_effort_brighten_background, best_effort_brighten_foreground,
  * allow_extended_colours, pickup_thrown, easy_exit_menu,
- * dos_use_background_intensity, autopickup_on`; documented in
- * `docs/options_guide.txt`.
+ * dos_use_background_intensity, pregen_background, autopickup_on`;
+ * documented in `docs/options_guide.txt`.
  *
  * It can also be used for global configuration of clua extensions.
  * @table options
@@ -77,6 +77,7 @@ static option_handler handlers[] =
     { "pickup_thrown",   &Options.pickup_thrown, option_hboolean },
     { "dos_use_background_intensity", &Options.dos_use_background_intensity,
                                       option_hboolean },
+    { "pregen_background", &Options.pregen_background, option_hboolean },
     { "autopick_on", nullptr, option_autopick }
 };
 
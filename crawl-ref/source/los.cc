@@ -45,6 +45,7 @@
 #include "los.h"
 
 #include <algorithm>
+#include <bitset>
 #include <cmath>
 
 #include "areas.h"
@@ -69,14 +70,27 @@ struct los_ray;
 static vector<los_ray> fullrays;
 static vector<coord_def> ray_coords;
 
+// A set of cells in one quadrant, one bit per cell (see _quadrant_bit).
+#define QUADRANT_CELLS ((LOS_MAX_RANGE+1) * (LOS_MAX_RANGE+1))
+typedef bitset<QUADRANT_CELLS> quadrant_mask;
+
+static inline int _quadrant_bit(const coord_def& p)
+{
+    return p.x * (LOS_MAX_RANGE+1) + p.y;
+}
+
 // These store all unique minimal cellrays. For each i,
 // cellray i ends in cellray_ends[i] and passes through
-// thoses cells p that have blockrays(p)[i] set. In other
-// words, blockrays(p)[i] is set iff an opaque cell p blocks
-// the cellray with index i.
+// those cells that are set in cellray_blockers[i], i.e.
+// an opaque cell p blocks the cellray with index i iff
+// bit _quadrant_bit(p) of cellray_blockers[i] is set.
 static vector<coord_def> cellray_ends;
+static vector<quadrant_mask> cellray_blockers;
+// The minimal cellrays ending in p are those with indices
+// cellray_range(p).first up to (excluding) cellray_range(p).second.
+static FixedArray<pair<int, int>, LOS_MAX_RANGE+1, LOS_MAX_RANGE+1>
+    cellray_range;
 typedef FixedArray<bit_vector*, LOS_MAX_RANGE+1, LOS_MAX_RANGE+1> blockrays_t;
-static blockrays_t blockrays;
 
 // We also store the minimal cellrays by target position
 // for efficient retrieval by find_ray.
@@ -84,12 +98,6 @@ static blockrays_t blockrays;
 struct cellray;
 static FixedArray<vector<cellray>, LOS_MAX_RANGE+1, LOS_MAX_RANGE+1> min_cellrays;
 
-// Temporary arrays used in losight() to track which rays
-// are blocked or have seen a smoke cloud.
-// Allocated when doing the precomputations.
-static bit_vector *dead_rays     = nullptr;
-static bit_vector *smoke_rays    = nullptr;
-
 class quadrant_iterator : public rectangle_iterator
 {
 public:
@@ -102,10 +110,8 @@ public:
 
 void clear_rays_on_exit()
 {
-    delete dead_rays;
-    delete smoke_rays;
-    for (quadrant_iterator qi; qi; ++qi)
-        delete blockrays(*qi);
+    cellray_ends.clear();
+    cellray_blockers.clear();
 }
 
 // LOS radius.
@@ -413,24 +419,32 @@ static void _create_blockrays()
     for (int i = 0; i < n_min_rays; ++i)
         cellray_ends[i] = ray_coords[min_indices[i]];
 
-    // Compress blockrays accordingly.
+    // Compress blockrays accordingly, transposing them so that each
+    // minimal cellray knows the set of cells blocking it.
+    cellray_blockers.resize(n_min_rays);
     for (quadrant_iterator qi; qi; ++qi)
     {
-        blockrays(*qi) = new bit_vector(n_min_rays);
+        const int bit = _quadrant_bit(*qi);
         for (int i = 0; i < n_min_rays; ++i)
-        {
-            blockrays(*qi)->set(i, all_blockrays(*qi)
-                                   ->get(min_indices[i]));
-        }
+            if (all_blockrays(*qi)->get(min_indices[i]))
+                cellray_blockers[i].set(bit);
+    }
+
+    // _find_minimal_cellrays returns the cellrays grouped by end cell.
+    for (int i = 0; i < n_min_rays; ++i)
+    {
+        pair<int, int> &range = cellray_range(cellray_ends[i]);
+        if (range.first == range.second)
+            range.first = i;
+        else
+            ASSERT(range.second == i);
+        range.second = i + 1;
     }
 
     // We can throw away all_blockrays now.
     for (quadrant_iterator qi; qi; ++qi)
         delete all_blockrays(*qi);
 
-    dead_rays  = new bit_vector(n_min_rays);
-    smoke_rays = new bit_vector(n_min_rays);
-
     dprf("Cellrays: %d Fullrays: %u Minimal cellrays: %u",
           n_cellrays, (unsigned int)fullrays.size(), n_min_rays);
 }
@@ -589,6 +603,48 @@ static bool _find_ray_se(const coord_def& target, ray_def& ray,
     return true;
 }
 
+// Can the opacity of cell e matter for seeing d from the origin?
+// That is the case iff e blocks some minimal cellray ending in d.
+static bool _blocks_cellray_to(coord_def d, coord_def e)
+{
+    if (d.x < 0)
+    {
+        d.x = -d.x;
+        e.x = -e.x;
+    }
+    if (d.y < 0)
+    {
+        d.y = -d.y;
+        e.y = -e.y;
+    }
+    // Cellrays stay within the rectangle spanned by their ends.
+    if (e.x < 0 || e.y < 0 || e.x > d.x || e.y > d.y)
+        return false;
+
+    const int bit = _quadrant_bit(e);
+    const pair<int, int> &range = cellray_range(d);
+    for (int i = range.first; i < range.second; ++i)
+        if (cellray_blockers[i].test(bit))
+            return true;
+    return false;
+}
+
+// Might a change in opacity at c change whether source and target
+// see each other? This is conservative for both directions, so callers
+// caching LOS between two cells can safely keep it if this is false.
+bool cell_in_los_path(const coord_def& source, const coord_def& target,
+                      const coord_def& c)
+{
+    const coord_def d = target - source;
+    if (d.origin() || d.rdist() > LOS_MAX_RANGE)
+        return false;
+
+    raycast();
+
+    return _blocks_cellray_to(d, c - source)
+           || _blocks_cellray_to(-d, c - target);
+}
+
 // Coordinate transformation so we can find_ray quadrant-by-quadrant.
 struct opacity_trans : public opacity_func
 {
@@ -763,9 +819,10 @@ bool cell_see_cell_nocache(const coord_def& p1, const coord_def& p2)
 // Mark, for each one, which cells kill it (and where.)
 // Also, for each one, note which cells it passes.
 // ACTUAL LOS:
-// Unite the ray-killers for the given map; this tells you which rays
-// are dead.
-// Look up which cells the surviving rays have, and that's your LOS!
+// Collect the opaque cells of the given map into a bitmap; a ray is
+// dead if its set of cells meets that bitmap.
+// A cell is visible if any of the rays ending in it survives, and
+// that's your LOS!
 // OPTIMIZATIONS:
 // WLOG, we can assume that we're in a specific quadrant - say the
 // first quadrant - and just mirror everything after that. We can
@@ -784,19 +841,19 @@ bool cell_see_cell_nocache(const coord_def& p1, const coord_def& p2)
 // PERFORMANCE:
 // With reasonable values we have around 6000 cellrays, meaning
 // around 600Kb (75 KB) of data. This gets cut down to 700 cellrays
-// after removing duplicates. That means that we need to do
-// around 22*100*4 ~ 9,000 memory reads + writes per LOS call on a
-// 32-bit system. Not too bad.
+// after removing duplicates. A quadrant has 81 cells, so every
+// cellray's cells fit into two 64-bit words, and checking a ray is a
+// couple of ANDs. Since we stop at the first surviving ray for each
+// cell, open areas cost about one check per cell, and a quadrant
+// without any opaque cells costs none at all.
 // IMPROVEMENTS:
 // Smoke will now only block LOS after two cells of smoke. This is
 // done by updating with a second array.
 
 static void _losight_quadrant(los_grid& sh, const los_param& dat, int sx, int sy)
 {
-    const unsigned int num_cellrays = cellray_ends.size();
-
-    dead_rays->reset();
-    smoke_rays->reset();
+    quadrant_mask opaque;
+    quadrant_mask smoke;
 
     for (quadrant_iterator qi; qi; ++qi)
     {
@@ -807,31 +864,37 @@ static void _losight_quadrant(los_grid& sh, const los_param& dat, int sx, int sy
         switch (dat.opacity(p))
         {
         case OPC_OPAQUE:
-            // Block the appropriate rays.
-            *dead_rays |= *blockrays(*qi);
+            opaque.set(_quadrant_bit(*qi));
             break;
         case OPC_HALF:
-            // Block rays which have already seen a cloud.
-            *dead_rays  |= (*smoke_rays & *blockrays(*qi));
-            *smoke_rays |= *blockrays(*qi);
+            smoke.set(_quadrant_bit(*qi));
             break;
         default:
             break;
         }
     }
 
-    // Ray calculation done. Now work out which cells in this
-    // quadrant are visible.
-    for (unsigned int rayidx = 0; rayidx < num_cellrays; ++rayidx)
+    const bool all_clear = opaque.none() && smoke.none();
+
+    // Now work out which cells in this quadrant are visible: a cell is
+    // visible if some cellray ending in it meets no opaque cell and at
+    // most one cloud.
+    for (quadrant_iterator qi; qi; ++qi)
     {
-        // make the cells seen by this ray at this point visible
-        if (!dead_rays->get(rayidx))
+        const coord_def p = coord_def(sx*(qi->x), sy*(qi->y));
+        if (!dat.los_bounds(p))
+            continue;
+
+        const pair<int, int> &range = cellray_range(*qi);
+        for (int i = range.first; i < range.second; ++i)
         {
-            // This ray is alive, thus the end cell is visible.
-            const coord_def p = coord_def(sx * cellray_ends[rayidx].x,
-                                          sy * cellray_ends[rayidx].y);
-            if (dat.los_bounds(p))
+            const quadrant_mask &cells = cellray_blockers[i];
+            if (all_clear
+                || ((cells & opaque).none() && (cells & smoke).count() < 2))
+            {
                 sh(p) = true;
+                break;
+            }
         }
     }
 }
@@ -2,6 +2,8 @@
 
 #include "losglobal.h"
 
+#include <cinttypes>
+
 #include "coord.h"
 #include "coordit.h"
 #include "libutil.h"
@@ -17,6 +19,54 @@ typedef halflos_t globallos_t[GXM][GYM];
 
 static globallos_t globallos;
 
+// invalidate_los() just bumps los_generation; the halflos of a cell is
+// wiped lazily once its halflos_generation is found to be out of date.
+static unsigned int los_generation = 1;
+static unsigned int halflos_generation[GXM][GYM];
+
+// For a cell at offset e from p, los_dependents[e.x][e.y + o_half_y]
+// lists those entries of p's halflos (as halflos indices) that may
+// depend on the opacity of the cell. Filled on first invalidation.
+static vector<coord_def> los_dependents[LOS_MAX_RANGE+1][2*LOS_MAX_RANGE+1];
+
+#ifdef DEBUG_LOS_PROFILING
+static struct
+{
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t invalidations;
+    uint64_t entries_cleared;
+    uint64_t full_invalidations;
+} _globallos_profile;
+
+void globallos_profile_out()
+{
+    const auto &pr = _globallos_profile;
+    const uint64_t lookups = pr.hits + pr.misses;
+    fprintf(stderr, "\nGlobal LOS cache:\n");
+    fprintf(stderr, "%12" PRIu64 " lookups, %" PRIu64 " hits (%.1f%%), "
+                    "%" PRIu64 " misses\n",
+            lookups, pr.hits, lookups ? pr.hits * 100.0 / lookups : 0.0,
+            pr.misses);
+    fprintf(stderr, "%12" PRIu64 " invalidations, %" PRIu64
+                    " known entries cleared, %" PRIu64 " full resets\n",
+            pr.invalidations, pr.entries_cleared, pr.full_invalidations);
+}
+#define LOS_PROFILE(field, n) (_globallos_profile.field += (n))
+#else
+#define LOS_PROFILE(field, n) ((void) 0)
+#endif
+
+static halflos_t& _halflos_at(const coord_def& p)
+{
+    if (halflos_generation[p.x][p.y] != los_generation)
+    {
+        memset(globallos[p.x][p.y], 0, sizeof(halflos_t));
+        halflos_generation[p.x][p.y] = los_generation;
+    }
+    return globallos[p.x][p.y];
+}
+
 static losfield_t* _lookup_globallos(const coord_def& p, const coord_def& q)
 {
     COMPILE_CHECK(LOS_KNOWN * 2 <= sizeof(losfield_t) * 8);
@@ -28,9 +78,33 @@ static losfield_t* _lookup_globallos(const coord_def& p, const coord_def& q)
         return nullptr;
     // p < q iff p.x < q.x || p.x == q.x && p.y < q.y
     if (diff < coord_def(0, 0))
-        return &globallos[q.x][q.y][-diff.x + o_half_x][-diff.y + o_half_y];
+        return &_halflos_at(q)[-diff.x + o_half_x][-diff.y + o_half_y];
     else
-        return &globallos[p.x][p.y][ diff.x + o_half_x][ diff.y + o_half_y];
+        return &_halflos_at(p)[ diff.x + o_half_x][ diff.y + o_half_y];
+}
+
+static void _init_los_dependents()
+{
+    for (int hx = 0; hx <= LOS_MAX_RANGE; hx++)
+        for (int hy = -LOS_MAX_RANGE; hy <= LOS_MAX_RANGE; hy++)
+        {
+            const coord_def diff(hx, hy);
+            // Only the upper half of the x == 0 column is ever used.
+            if (diff < coord_def(0, 0) || diff.origin())
+                continue;
+            // Cells that matter lie between the two ends, which
+            // bounds their offset to the halflos shape again.
+            for (int ex = 0; ex <= hx; ex++)
+                for (int ey = min(hy, 0); ey <= max(hy, 0); ey++)
+                {
+                    const coord_def e(ex, ey);
+                    if (cell_in_los_path(coord_def(0, 0), diff, e))
+                    {
+                        los_dependents[ex][ey + o_half_y].emplace_back(
+                            hx + o_half_x, hy + o_half_y);
+                    }
+                }
+        }
 }
 
 static void _save_los(los_def* los, los_type l)
@@ -58,22 +132,52 @@ static void _save_los(los_def* los, los_type l)
         }
 }
 
-// Opacity at p has changed.
+// Opacity at p has changed: forget about those pairs of cells
+// that might see each other through p.
 void invalidate_los_around(const coord_def& p)
 {
-    int x1 = max(p.x - LOS_MAX_RANGE, 0);
-    int y1 = max(p.y - LOS_MAX_RANGE, 0);
-    int x2 = min(p.x, GXM - 1);
-    int y2 = min(p.y + LOS_MAX_RANGE, GYM - 1);
-    for (int y = y1; y <= y2; y++)
-        for (int x = x1; x <= x2; x++)
-            memset(globallos[x][y], 0, sizeof(halflos_t));
+    static bool dependents_known = false;
+    if (!dependents_known)
+    {
+        _init_los_dependents();
+        dependents_known = true;
+    }
+
+    LOS_PROFILE(invalidations, 1);
+
+    // The pair (c, c + diff) is stored with c, and p lies between the two.
+    for (int ex = 0; ex <= LOS_MAX_RANGE; ex++)
+        for (int ey = -LOS_MAX_RANGE; ey <= LOS_MAX_RANGE; ey++)
+        {
+            const coord_def c = p - coord_def(ex, ey);
+            if (!map_bounds(c)
+                || halflos_generation[c.x][c.y] != los_generation)
+            {
+                continue;
+            }
+
+            halflos_t &half = globallos[c.x][c.y];
+            for (const coord_def &slot : los_dependents[ex][ey + o_half_y])
+            {
+                losfield_t &flags = half[slot.x][slot.y];
+                if (flags)
+                {
+                    LOS_PROFILE(entries_cleared, 1);
+                    flags = 0;
+                }
+            }
+        }
 }
 
 void invalidate_los()
 {
-    for (rectangle_iterator ri(0); ri; ++ri)
-        memset(globallos[ri->x][ri->y], 0, sizeof(halflos_t));
+    LOS_PROFILE(full_invalidations, 1);
+    if (++los_generation == 0)
+    {
+        // Wrapped around; make sure no stale halflos looks current.
+        memset(halflos_generation, 0, sizeof(halflos_generation));
+        los_generation = 1;
+    }
 }
 
 static void _update_globallos_at(const coord_def& p, los_type l)
@@ -124,7 +228,12 @@ bool cell_see_cell(const coord_def& p, const coord_def& q, los_type l)
         return false; // outside range
 
     if (!(*flags & (l << LOS_KNOWN)))
+    {
+        LOS_PROFILE(misses, 1);
         _update_globallos_at(p, l);
+    }
+    else
+        LOS_PROFILE(hits, 1);
 
     ASSERT(*flags & (l << LOS_KNOWN));
     return *flags & l;
@@ -543,10 +543,25 @@ static void _show_commandline_options_help()
     puts("");
     puts("Miscellaneous options:");
     puts("  -dump-maps       write map Lua to stderr when parsing .des files");
+    puts("  -vault-db        load maps from one shared, memory-mapped vault");
+    puts("                   database in the des cache, building it if needed");
+    puts("  -text-db <dir>   use the read-only text databases in <dir>, or");
+    puts("                   with -builddb, build them there");
 #ifndef TARGET_OS_WINDOWS
     puts("  -gdb/-no-gdb     produce gdb backtrace when a crash happens (default:on)");
 #endif
     puts("  -playable-json   list playable species, jobs, and character combos.");
+    puts("  -save-bench <dir> [<n>]  load and re-save every save in <dir> <n>");
+    puts("                   times (default 10) and report timings");
+    puts("  -arena-tournament <file>  run every arena spec in <file> without");
+    puts("                   display, -jobs <n> at a time, and write the");
+    puts("                   results to arena-tournament.csv");
+#ifdef WIZARD
+    puts("  -fsim <combo> [double]  run the fight simulator (see the fsim_*");
+    puts("                   options) as a new <combo> character, e.g. MiFi");
+#endif
+    puts("  -jobs <num>      number of worker processes for -arena-tournament,");
+    puts("                   -builddb, -fsim, -mapstat and -objstat");
 
 #if defined(TARGET_OS_WINDOWS) && defined(USE_TILE_LOCAL)
     text_popup(help, L"Dungeon Crawl command line help");
@@ -2176,6 +2176,16 @@ bool depth_ranges::is_usable_in(const level_id &lid) const
     return any_matched;
 }
 
+bool depth_ranges::may_be_usable_in(branch_type br) const
+{
+    // Deny ranges only ever rule levels out, and absolute depth ranges
+    // (branch NUM_BRANCHES) can match in any branch.
+    for (const level_range &lr : depths)
+        if (!lr.deny && (lr.branch == br || lr.branch == NUM_BRANCHES))
+            return true;
+    return false;
+}
+
 void depth_ranges::add_depths(const depth_ranges &other_depths)
 {
     depths.insert(depths.end(),
@@ -2202,7 +2212,8 @@ map_def::map_def()
       rock_colour(BLACK), floor_colour(BLACK), rock_tile(""),
       floor_tile(""), border_fill_type(DNGN_ROCK_WALL),
       tags(),
-      index_only(false), cache_offset(0L), validating_map_flag(false),
+      index_only(false), cache_offset(0L), cache_db(nullptr),
+      cache_db_len(0), validating_map_flag(false),
       cache_minivault(false), cache_overwritable(false), cache_extra(false)
 {
     init();
@@ -2402,6 +2413,12 @@ map_chance map_def::chance(const level_id &lid) const
     return _chance.depth_value(lid);
 }
 
+// Does the map have a CHANCE anywhere at all?
+bool map_def::has_chance() const
+{
+    return _chance.any_value([](const map_chance &c) { return c.valid(); });
+}
+
 string map_def::describe() const
 {
     return make_stringf("Map: %s\n%s%s%s%s%s%s",
@@ -2438,6 +2455,22 @@ void map_def::load()
     if (!index_only)
         return;
 
+    if (cache_db)
+    {
+        // No file to open or lock: the database is never rewritten in
+        // place, so the pages we have mapped stay valid.
+        if (cache_offset < 0 || (size_t) cache_offset >= cache_db_len)
+        {
+            throw map_load_exception(
+                    make_stringf("Map offset is invalid: %s", name.c_str()));
+        }
+        reader inf(cache_db + cache_offset, cache_db_len - cache_offset,
+                   TAG_MINOR_VERSION);
+        read_full(inf, true);
+        index_only = false;
+        return;
+    }
+
     const string descache_base = get_descache_path(cache_name, "");
     file_lock deslock(descache_base + ".lk", "rb", false);
     const string loadfile = descache_base + ".dsc";
@@ -2547,6 +2580,12 @@ void map_def::set_file(const string &s)
     cache_name = get_cache_name(s);
 }
 
+void map_def::set_cache_db(const unsigned char *full, size_t len)
+{
+    cache_db = full;
+    cache_db_len = len;
+}
+
 string map_def::run_lua(bool run_main)
 {
     dlua_set_map mset(this);
@@ -976,6 +976,8 @@ public:
     void clear() { depths.clear(); }
     bool empty() const { return depths.empty(); }
     bool is_usable_in(const level_id &lid) const;
+    // Could is_usable_in() be true for some level in this branch?
+    bool may_be_usable_in(branch_type br) const;
     void add_depth(const level_range &range) { depths.push_back(range); }
     void add_depths(const depth_ranges &other_ranges);
     string describe() const;
@@ -1040,6 +1042,17 @@ public:
     {
         depth_range_Xs.push_back(depth_range_X<X>(depth_range_string, thing));
     }
+    // Whether pred holds for the default or for any of the ranged values.
+    template <typename pred_type>
+    bool any_value(pred_type pred) const
+    {
+        if (pred(default_thing))
+            return true;
+        for (const auto &range : depth_range_Xs)
+            if (pred(range.depth_thing))
+                return true;
+        return false;
+    }
     X depth_value(const level_id &lid) const
     {
         typename depth_range_X_v::const_iterator i = depth_range_Xs.begin();
@@ -1162,6 +1175,10 @@ private:
     bool            index_only;
     mutable long    cache_offset;
     string          cache_name;
+    // The full definitions section of the vault database this map was
+    // indexed from, if any; cache_offset is then relative to it.
+    const unsigned char *cache_db;
+    size_t          cache_db_len;
 
     typedef Matrix<bool> subvault_mask;
     subvault_mask *svmask;
@@ -1192,6 +1209,7 @@ public:
 
     int weight(const level_id &lid) const;
     map_chance chance(const level_id &lid) const;
+    bool has_chance() const;
 
     bool in_map(const coord_def &p) const;
     bool map_already_used() const;
@@ -1211,6 +1229,7 @@ public:
     void read_maplines(reader&);
 
     void set_file(const string &s);
+    void set_cache_db(const unsigned char *full, size_t len);
     string run_lua(bool skip_main);
     bool run_hook(const string &hook_name, bool die_on_lua_error = false);
     bool run_postplace_hook(bool die_on_lua_error = false);
@@ -8,13 +8,21 @@
 #include "maps.h"
 
 #include <algorithm>
+#include <chrono>
 #include <cstdlib>
 #include <cstring>
+#include <fcntl.h>
 #include <sys/param.h>
+#include <sys/stat.h>
 #include <sys/types.h>
+#include <unordered_map>
 #ifndef TARGET_COMPILER_VC
 #include <unistd.h>
 #endif
+#ifdef UNIX
+#include <sys/mman.h>
+#include <sys/wait.h>
+#endif
 
 #include "branch.h"
 #include "coord.h"
@@ -24,6 +32,7 @@
 #include "end.h"
 #include "endianness.h"
 #include "files.h"
+#include "initfile.h"
 #include "mapmark.h"
 #include "message.h"
 #include "state.h"
@@ -67,6 +76,99 @@ point_vector map_anchor_points;
 
 static map_vector vdefs;
 
+typedef vector<unsigned> vault_indices;
+
+// Lists of the vdefs that a selector could possibly accept, so that picking
+// a map doesn't have to test every map we know about. Each list keeps vdefs
+// order, so filtering one with map_selector::accept() gives exactly what a
+// scan of all of vdefs would, and the same maps get chosen for a seed.
+struct vault_index
+{
+    vault_index() : built(false) { }
+
+    // Which list of a branch a map goes in.
+    static int category(bool mini, bool extra) { return mini + 2 * extra; }
+
+    bool built;
+    vault_indices all;
+    unordered_map<string, vault_indices> by_tag;
+    // Maps whose PLACE: or DEPTH: may include a level of the branch.
+    vault_indices by_place[NUM_BRANCHES][4];
+    vault_indices by_depth[NUM_BRANCHES][4];
+    // Maps in by_depth with a CHANCE, split only by extra.
+    vault_indices by_chance[NUM_BRANCHES][2];
+};
+
+static vault_index vindex;
+
+// Must be called whenever vdefs, or the tags or depths of a map in it, change.
+static void _invalidate_vault_index()
+{
+    vindex.built = false;
+}
+
+static const vault_index &_vault_index()
+{
+    if (vindex.built)
+        return vindex;
+
+    vindex.all.clear();
+    vindex.by_tag.clear();
+    for (int br = 0; br < NUM_BRANCHES; ++br)
+    {
+        for (vault_indices &maps : vindex.by_place[br])
+            maps.clear();
+        for (vault_indices &maps : vindex.by_depth[br])
+            maps.clear();
+        for (vault_indices &maps : vindex.by_chance[br])
+            maps.clear();
+    }
+
+    for (unsigned i = 0, size = vdefs.size(); i < size; ++i)
+    {
+        const map_def &map = vdefs[i];
+        vindex.all.push_back(i);
+        for (const string &tag : map.get_tags_unsorted())
+            vindex.by_tag[tag].push_back(i);
+
+        const bool extra = map.is_extra_vault();
+        const int cat = vault_index::category(map.is_minivault(), extra);
+        const bool chance = map.has_chance();
+        for (int br = 0; br < NUM_BRANCHES; ++br)
+        {
+            const branch_type branch = static_cast<branch_type>(br);
+            if (map.place.may_be_usable_in(branch))
+                vindex.by_place[br][cat].push_back(i);
+            if (map.depths.may_be_usable_in(branch))
+            {
+                vindex.by_depth[br][cat].push_back(i);
+                if (chance)
+                    vindex.by_chance[br][extra].push_back(i);
+            }
+        }
+    }
+
+    vindex.built = true;
+    return vindex;
+}
+
+// The shortest index list that every map with all of the tags is on.
+static const vault_indices &_maps_with_tags(const unordered_set<string> &tags)
+{
+    static const vault_indices none;
+    const vault_index &index = _vault_index();
+    const vault_indices *best = &index.all;
+    for (const string &tag : tags)
+    {
+        auto it = index.by_tag.find(tag);
+        if (it == index.by_tag.end())
+            return none;
+        if (it->second.size() < best->size())
+            best = &it->second;
+    }
+    return *best;
+}
+
 // Parameter array that vault code can use.
 string_vector map_parameters;
 
@@ -732,8 +834,9 @@ mapref_vector find_maps_for_tag(const string &tag,
     level_id place = level_id::current();
     unordered_set<string> tag_set = parse_tags(tag);
 
-    for (const map_def &mapdef : vdefs)
+    for (unsigned i : _maps_with_tags(tag_set))
     {
+        const map_def &mapdef = vdefs[i];
         if (mapdef.has_all_tags(tag_set.begin(), tag_set.end())
             && !mapdef.has_tag("dummy")
             && (!check_depth || !mapdef.has_depth()
@@ -759,6 +862,7 @@ private:
 
 public:
     bool accept(const map_def &md) const;
+    vault_indices candidates() const;
     void announce(const map_def *map) const;
 
     bool valid() const
@@ -901,6 +1005,34 @@ bool map_selector::accept(const map_def &mapdef) const
     }
 }
 
+/// The maps that accept() might take, in vdefs order.
+vault_indices map_selector::candidates() const
+{
+    const vault_index &index = _vault_index();
+    if (sel == TAG)
+        return _maps_with_tags(parse_tags(tag));
+
+    ASSERT_RANGE(place.branch, 0, NUM_BRANCHES);
+    vault_indices maps;
+    for (int want_extra = 0; want_extra < 2; ++want_extra)
+    {
+        if (!_is_extra_compatible(extra, want_extra))
+            continue;
+
+        const vault_indices &list =
+            sel == PLACE ? index.by_place[place.branch]
+                               [vault_index::category(mini, want_extra)] :
+            sel == DEPTH ? index.by_depth[place.branch]
+                               [vault_index::category(mini, want_extra)]
+                         : index.by_chance[place.branch][want_extra];
+        maps.insert(maps.end(), list.begin(), list.end());
+    }
+    // Extra and non-extra maps were appended separately.
+    if (extra == MB_MAYBE)
+        sort(maps.begin(), maps.end());
+    return maps;
+}
+
 void map_selector::announce(const map_def *vault) const
 {
 #ifdef DEBUG_DIAGNOSTICS
@@ -939,15 +1071,13 @@ string vault_chance_tag(const map_def &map)
     return "";
 }
 
-typedef vector<unsigned> vault_indices;
-
 static vault_indices _eligible_maps_for_selector(const map_selector &sel)
 {
     vault_indices eligible;
 
     if (sel.valid())
     {
-        for (unsigned i = 0, size = vdefs.size(); i < size; ++i)
+        for (unsigned i : sel.candidates())
             if (sel.accept(vdefs[i]))
                 eligible.push_back(i);
     }
@@ -1260,26 +1390,43 @@ static bool _verify_map_full(const string &base, time_t mtime)
     return verify_file_version(base + ".dsc", mtime);
 }
 
-static bool _load_map_index(const string& cache, const string &base,
-                            time_t mtime)
+// Read the cached global prelude of a .des file into prelude, which is left
+// empty if the file has none. Returns false if the cache is out of date.
+static bool _load_map_prelude(const string &base, time_t mtime,
+                              dlua_chunk &prelude)
 {
-    // If there's a global prelude, load that first.
-    if (FILE *fp = fopen_u((base + ".lux").c_str(), "rb"))
-    {
-        reader inf(fp, TAG_MINOR_VERSION);
-        uint8_t major = unmarshallUByte(inf);
-        uint8_t minor = unmarshallUByte(inf);
-        int8_t word = unmarshallByte(inf);
-        int64_t t = unmarshallSigned(inf);
-        if (major != TAG_MAJOR_VERSION || minor > TAG_MINOR_VERSION
-            || word != WORD_LEN || t != mtime)
-        {
-            return false;
-        }
+    prelude.clear();
+    FILE *fp = fopen_u((base + ".lux").c_str(), "rb");
+    if (!fp)
+        return true;
 
-        lc_global_prelude.read(inf);
+    reader inf(fp, TAG_MINOR_VERSION);
+    uint8_t major = unmarshallUByte(inf);
+    uint8_t minor = unmarshallUByte(inf);
+    int8_t word = unmarshallByte(inf);
+    int64_t t = unmarshallSigned(inf);
+    if (major != TAG_MAJOR_VERSION || minor > TAG_MINOR_VERSION
+        || word != WORD_LEN || t != mtime)
+    {
         fclose(fp);
+        return false;
+    }
+
+    prelude.read(inf);
+    fclose(fp);
+    return true;
+}
 
+static bool _load_map_index(const string& cache, const string &base,
+                            time_t mtime)
+{
+    // If there's a global prelude, load that first.
+    dlua_chunk prelude;
+    if (!_load_map_prelude(base, mtime, prelude))
+        return false;
+    if (!prelude.empty())
+    {
+        lc_global_prelude = prelude;
         global_preludes.push_back(lc_global_prelude);
     }
 
@@ -1308,6 +1455,7 @@ static bool _load_map_index(const string& cache, const string &base,
     const int nmaps = unmarshallShort(inf);
     const int nexist = vdefs.size();
     vdefs.resize(nexist + nmaps, map_def());
+    _invalidate_vault_index();
     for (int i = 0; i < nmaps; ++i)
     {
         map_def &vdef(vdefs[nexist + i]);
@@ -1316,6 +1464,16 @@ static bool _load_map_index(const string& cache, const string &base,
         vdef.order = unmarshallInt(inf);
 
         vdef.set_file(cache);
+        // Files compiled by different -builddb workers weren't checked
+        // against each other by the parser.
+        auto loaded = lc_loaded_maps.find(vdef.name);
+        if (loaded != lc_loaded_maps.end())
+        {
+            end(1, false, "%s:%d: Map named '%s' already loaded at %s:%d",
+                vdef.place_loaded_from.filename.c_str(),
+                vdef.place_loaded_from.lineno, vdef.name.c_str(),
+                loaded->second.filename.c_str(), loaded->second.lineno);
+        }
         lc_loaded_maps[vdef.name] = vdef.place_loaded_from;
         vdef.place_loaded_from.clear();
     }
@@ -1421,17 +1579,280 @@ static void _write_map_cache(const string &filename, size_t vs, size_t ve,
     _write_map_index(descache_base, vs, ve, mtime);
 }
 
-static void _parse_maps(const string &s)
+////////////////////////////////////////////////////////////////////////////
+// The packed vault database (-vault-db).
+//
+// Instead of an .idx/.dsc/.lux triple per .des file, des/vaults.db holds
+// the index entries, global preludes and full definitions of every map.
+// Each process maps it read-only once, and map_def::load() decodes
+// straight from the shared pages, with no file to open or lock. The
+// database is only ever replaced by renaming a new one over it, never
+// rewritten in place, so a process's mapping stays valid.
+//
+// Layout: major, minor and word length bytes, then the sizes of the index
+// and full sections as ints, then the two sections. The index has, for
+// each .des file in load order, its cache name, mtime, global prelude and
+// the maps' index entries. Map cache_offsets are relative to the start of
+// the full section, which begins with a copy of the version bytes so that
+// no offset is 0.
+
+static const char *VAULT_DB_FILE = "vaults.db";
+static const size_t VAULT_DB_HEADER_LEN = 3 + 2 * sizeof(int32_t);
+
+// One .des file's worth of the database.
+struct vault_db_file
+{
+    int64_t mtime;
+    dlua_chunk prelude;
+    vector<map_def> maps;
+};
+
+// What was loaded from each .des file, in order, to write the database.
+struct des_file_record
 {
-    string cache_name = get_cache_name(s);
-    if (map_files_read.count(cache_name))
+    string cache_name;
+    int64_t mtime;
+    dlua_chunk prelude;
+    size_t first_map, last_map;
+};
+
+struct vault_db_state
+{
+    // The .des files in the open database not yet loaded by _parse_maps().
+    map<string, vault_db_file> files;
+    // Whether the database needs writing out after the maps are loaded.
+    bool stale = false;
+    vector<des_file_record> loaded;
+};
+
+static vault_db_state vault_db;
+
+/**
+ * Map the whole of a file read-only, or read it into memory where it can't
+ * be mapped. The memory is never released: map_defs copied out of vdefs
+ * keep pointing into it for as long as the game runs.
+ *
+ * @return nullptr if the file can't be opened or is empty.
+ */
+static const unsigned char *_map_file(const string &filename, size_t &len)
+{
+    const int fd = open_u(filename.c_str(), O_RDONLY, 0);
+    if (fd == -1)
+        return nullptr;
+
+    struct stat st;
+    if (fstat(fd, &st) || st.st_size <= 0)
+    {
+        close(fd);
+        return nullptr;
+    }
+    len = st.st_size;
+
+#ifdef UNIX
+    void *data = mmap(nullptr, len, PROT_READ, MAP_SHARED, fd, 0);
+    if (data != MAP_FAILED)
+    {
+        close(fd);
+        return static_cast<const unsigned char *>(data);
+    }
+    dprf("Can't map %s, reading it instead", filename.c_str());
+#endif
+
+    unsigned char *copy = new unsigned char[len];
+    size_t got = 0;
+    while (got < len)
+    {
+        const ssize_t n = read(fd, copy + got, len - got);
+        if (n <= 0)
+            break;
+        got += n;
+    }
+    close(fd);
+    if (got < len)
+    {
+        delete[] copy;
+        return nullptr;
+    }
+    return copy;
+}
+
+static bool _read_vault_db_index(reader &inf, const unsigned char *full,
+                                 size_t full_len)
+{
+    const int nfiles = unmarshallInt(inf);
+    for (int i = 0; i < nfiles; ++i)
+    {
+        const string cache_name = unmarshallString(inf);
+        vault_db_file &file = vault_db.files[cache_name];
+        file.mtime = unmarshallSigned(inf);
+        if (unmarshallBoolean(inf))
+            file.prelude.read(inf);
+
+        const int nmaps = unmarshallInt(inf);
+        if (nmaps < 0)
+            return false;
+        file.maps.resize(nmaps);
+        for (map_def &vdef : file.maps)
+        {
+            vdef.read_index(inf);
+            vdef.description = unmarshallString(inf);
+            vdef.order = unmarshallInt(inf);
+            vdef.set_file(cache_name);
+            vdef.set_cache_db(full, full_len);
+        }
+    }
+    return true;
+}
+
+// Map the vault database, if there is a usable one, and read its index.
+static void _open_vault_db()
+{
+    vault_db.files.clear();
+    vault_db.loaded.clear();
+    vault_db.stale = true;
+
+    const string dbfile = _des_cache_dir(VAULT_DB_FILE);
+    size_t len = 0;
+    const unsigned char *data = _map_file(dbfile, len);
+    if (!data)
         return;
 
-    map_files_read.insert(cache_name);
+    bool ok = false;
+    try
+    {
+        reader header(data, len, TAG_MINOR_VERSION);
+        header.set_safe_read(true);
+        const uint8_t major = unmarshallUByte(header);
+        const uint8_t minor = unmarshallUByte(header);
+        const int8_t word = unmarshallByte(header);
+        const size_t index_len = (uint32_t) unmarshallInt(header);
+        const size_t full_len = (uint32_t) unmarshallInt(header);
+
+        if (major == TAG_MAJOR_VERSION && minor <= TAG_MINOR_VERSION
+            && word == WORD_LEN
+            && VAULT_DB_HEADER_LEN + index_len + full_len == len)
+        {
+            const unsigned char *index = data + VAULT_DB_HEADER_LEN;
+            reader inf(index, index_len, TAG_MINOR_VERSION);
+            inf.set_safe_read(true);
+            ok = _read_vault_db_index(inf, index + index_len, full_len);
+        }
+    }
+    catch (short_read_exception &E)
+    {
+        ok = false;
+    }
 
-    if (_load_map_cache(s, cache_name))
+    if (!ok)
+    {
+        mprf(MSGCH_ERROR, "Ignoring damaged vault database %s",
+             dbfile.c_str());
+        vault_db.files.clear();
         return;
+    }
+    vault_db.stale = false;
+}
+
+// Load a .des file's maps from the vault database if it has them and they
+// are up to date.
+static bool _load_map_db(const string &cache_name, int64_t mtime)
+{
+    auto it = vault_db.files.find(cache_name);
+    if (it == vault_db.files.end() || it->second.mtime != mtime)
+    {
+        vault_db.stale = true;
+        return false;
+    }
+
+    vault_db_file &file = it->second;
+    if (!file.prelude.empty())
+        global_preludes.push_back(file.prelude);
+
+    for (map_def &vdef : file.maps)
+    {
+        lc_loaded_maps[vdef.name] = vdef.place_loaded_from;
+        vdef.place_loaded_from.clear();
+        vdefs.push_back(move(vdef));
+    }
+    _invalidate_vault_index();
+    vault_db.files.erase(it);
+    return true;
+}
+
+// Write out a new vault database of everything read_maps() loaded.
+static void _write_vault_db()
+{
+    _check_des_index_dir();
+
+    vector<unsigned char> index_buf, full_buf;
+    writer index(&index_buf);
+    writer full(&full_buf);
+    marshallUByte(full, TAG_MAJOR_VERSION);
+    marshallUByte(full, TAG_MINOR_VERSION);
+    marshallByte(full, WORD_LEN);
+
+    marshallInt(index, vault_db.loaded.size());
+    for (const des_file_record &file : vault_db.loaded)
+    {
+        marshallString(index, file.cache_name);
+        marshallSigned(index, file.mtime);
+        marshallBoolean(index, !file.prelude.empty());
+        if (!file.prelude.empty())
+            file.prelude.write(index);
+
+        marshallInt(index, file.last_map - file.first_map);
+        for (size_t i = file.first_map; i < file.last_map; ++i)
+        {
+            map_def vdef = vdefs[i];
+            try
+            {
+                vdef.load();
+            }
+            catch (map_load_exception &mload)
+            {
+                mprf(MSGCH_ERROR, "Can't write the vault database: %s",
+                     mload.what());
+                return;
+            }
+            vdef.write_full(full);
+            vdef.place_loaded_from = lc_loaded_maps[vdef.name];
+            vdef.write_index(index);
+            marshallString(index, vdef.description);
+            marshallInt(index, vdef.order);
+        }
+    }
+
+    const string dbfile = _des_cache_dir(VAULT_DB_FILE);
+    const string tmpfile = dbfile + ".tmp";
+    file_lock dblock(_des_cache_dir("vaults.lk"), "wb");
+
+    FILE *fp = fopen_replace(tmpfile.c_str());
+    if (!fp)
+        end(1, true, "Unable to open %s for writing", tmpfile.c_str());
+    {
+        writer outf(tmpfile, fp);
+        marshallUByte(outf, TAG_MAJOR_VERSION);
+        marshallUByte(outf, TAG_MINOR_VERSION);
+        marshallByte(outf, WORD_LEN);
+        marshallInt(outf, index_buf.size());
+        marshallInt(outf, full_buf.size());
+        outf.write(index_buf.data(), index_buf.size());
+        outf.write(full_buf.data(), full_buf.size());
+    }
+    fclose(fp);
 
+    if (rename_u(tmpfile.c_str(), dbfile.c_str()))
+        end(1, true, "Unable to replace %s", dbfile.c_str());
+}
+
+/**
+ * Parse a .des file and write its cache files.
+ *
+ * @return how long that took, in microseconds.
+ */
+static int64_t _compile_maps(const string &s, const string &cache_name)
+{
+    const auto start = chrono::steady_clock::now();
     FILE *dat = fopen_u(s.c_str(), "r");
     if (!dat)
         end(1, true, "Failed to open %s for reading", s.c_str());
@@ -1456,10 +1877,281 @@ static void _parse_maps(const string &s)
     global_preludes.push_back(lc_global_prelude);
 
     _write_map_cache(cache_name, file_start, vdefs.size(), mtime);
+    return chrono::duration_cast<chrono::microseconds>(
+               chrono::steady_clock::now() - start).count();
+}
+
+static void _report_compile_time(const string &s, int64_t usecs)
+{
+    printf("Compiled %s in %.3fs\n", s.c_str(), usecs / 1000000.0);
+    fflush(stdout);
+}
+
+// Is the des cache for this file up to date?
+static bool _map_cache_current(const string &s)
+{
+    const string descache_base = get_descache_path(get_cache_name(s), "");
+    const time_t mtime = file_modtime(s);
+    return _verify_map_index(descache_base, mtime)
+           && _verify_map_full(descache_base, mtime);
+}
+
+static void _parse_maps(const string &s)
+{
+    string cache_name = get_cache_name(s);
+    if (map_files_read.count(cache_name))
+        return;
+
+    map_files_read.insert(cache_name);
+
+    if (!SysEnv.vault_db)
+    {
+        if (!_load_map_cache(s, cache_name))
+        {
+            const int64_t usecs = _compile_maps(s, cache_name);
+            if (crawl_state.build_db)
+                _report_compile_time(s, usecs);
+        }
+        return;
+    }
+
+    const int64_t mtime = file_modtime(s);
+    const size_t file_start = vdefs.size();
+    const size_t prelude_start = global_preludes.size();
+    if (!_load_map_db(cache_name, mtime) && !_load_map_cache(s, cache_name))
+    {
+        const int64_t usecs = _compile_maps(s, cache_name);
+        if (crawl_state.build_db)
+            _report_compile_time(s, usecs);
+    }
+
+    des_file_record file;
+    file.cache_name = cache_name;
+    file.mtime = mtime;
+    if (global_preludes.size() > prelude_start)
+        file.prelude = global_preludes.back();
+    file.first_map = file_start;
+    file.last_map = vdefs.size();
+    vault_db.loaded.push_back(file);
+}
+
+// If set, read_map() only lists the files it is asked to read.
+static vector<string> *des_files_wanted = nullptr;
+
+#ifdef UNIX
+// Run the cached global prelude of a .des file, as parsing the file would.
+static void _run_cached_map_prelude(const string &s)
+{
+    dlua_chunk prelude;
+    if (_load_map_prelude(get_descache_path(get_cache_name(s), ""),
+                          file_modtime(s), prelude)
+        && !prelude.empty()
+        && prelude.load_call(dlua, nullptr))
+    {
+        mprf(MSGCH_ERROR, "Lua error: %s", prelude.orig_error().c_str());
+    }
+}
+
+// Body of a forked -builddb worker: compile the given files, and send back
+// the index and compile time of each, or -1 if it failed.
+//
+// Before compiling a file, the worker runs the global preludes of the files
+// before it that it can find: those whose cache was current to begin with
+// (cached), and those it has compiled itself. Any other file, still being
+// compiled by another worker, is skipped, so a file needing its prelude can
+// fail here. Each file is compiled in a process of its own, so that such a
+// failure only sends that one file back to the normal pass.
+NORETURN static void _des_worker(const vector<string> &files,
+                                 vector<bool> cached, const vector<int> &mine,
+                                 FILE *out)
+{
+    // The parent compiles again, and so reports, anything that fails here.
+    const int devnull = open("/dev/null", O_RDWR);
+    if (devnull != -1)
+    {
+        dup2(devnull, STDOUT_FILENO);
+        dup2(devnull, STDERR_FILENO);
+        close(devnull);
+    }
+
+    writer th("des compile times", out);
+    int replayed = 0;
+    for (int i : mine)
+    {
+        for (; replayed < i; ++replayed)
+            if (cached[replayed])
+                _run_cached_map_prelude(files[replayed]);
+        _dgn_flush_map_environments();
+        dlua.gc();
+
+        fflush(out);
+        const pid_t pid = fork();
+        if (!pid)
+        {
+            const string &s = files[i];
+            map_files_read.insert(get_cache_name(s));
+            lc_desfile = s;
+            const int64_t usecs = _compile_maps(s, get_cache_name(s));
+            marshallInt(th, i);
+            marshallSigned(th, usecs);
+            fflush(out);
+            _exit(0);
+        }
+
+        int status = 0;
+        if (pid != -1 && waitpid(pid, &status, 0) == pid
+            && WIFEXITED(status) && !WEXITSTATUS(status))
+        {
+            cached[i] = true;
+        }
+        else
+        {
+            marshallInt(th, i);
+            marshallSigned(th, -1);
+            fflush(out);
+        }
+    }
+    fclose(out);
+    _exit(0);
+}
+
+/**
+ * Compile the stale .des files on SysEnv.jobs worker processes, so that the
+ * normal pass of loadmaps.lua then finds every cache up to date. Each file
+ * is compiled on its own, as in a serial build, so the cache files are the
+ * same; only the duplicate map name check across files is left to
+ * _load_map_index().
+ */
+static void _compile_maps_parallel()
+{
+    vector<string> files;
+    {
+        unwind_var<vector<string> *> listing(des_files_wanted, &files);
+        if (dlua.execfile("dlua/loadmaps.lua", true, true, true))
+            end(1, false, "Lua error: %s", dlua.error.c_str());
+    }
+
+    vector<int> stale;
+    vector<bool> cached(files.size());
+    for (int i = 0, size = files.size(); i < size; ++i)
+    {
+        cached[i] = _map_cache_current(files[i]);
+        if (!cached[i])
+            stale.push_back(i);
+    }
+    if (stale.size() < 2)
+        return;
+
+    // Hand out the biggest files first, each to the least loaded worker.
+    const int jobs = min<int>(SysEnv.jobs, stale.size());
+    vector<off_t> sizes(files.size());
+    for (int i : stale)
+        if (FILE *fp = fopen_u(files[i].c_str(), "r"))
+        {
+            sizes[i] = file_size(fp);
+            fclose(fp);
+        }
+    vector<int> by_size = stale;
+    stable_sort(by_size.begin(), by_size.end(),
+                [&](int a, int b) { return sizes[a] > sizes[b]; });
+    vector<vector<int>> shares(jobs);
+    vector<off_t> load(jobs);
+    vector<int> owner(files.size(), -1);
+    for (int i : by_size)
+    {
+        const int job = min_element(load.begin(), load.end()) - load.begin();
+        shares[job].push_back(i);
+        load[job] += sizes[i];
+        owner[i] = job;
+    }
+    for (vector<int> &share : shares)
+        sort(share.begin(), share.end());
+
+    printf("Compiling %u des files with %d workers\n",
+           (unsigned int) stale.size(), jobs);
+    fflush(stdout);
+    fflush(stderr);
+
+    vector<pid_t> pids;
+    vector<FILE *> results;
+    for (int job = 0; job < jobs; ++job)
+    {
+        int fds[2];
+        if (pipe(fds))
+        {
+            perror("pipe");
+            break;
+        }
+
+        const pid_t pid = fork();
+        if (pid == -1)
+        {
+            perror("fork");
+            close(fds[0]);
+            close(fds[1]);
+            break;
+        }
+
+        if (!pid)
+        {
+            close(fds[0]);
+            for (FILE *fp : results)
+                fclose(fp);
+            _des_worker(files, cached, shares[job], fdopen(fds[1], "wb"));
+        }
+
+        close(fds[1]);
+        pids.push_back(pid);
+        results.push_back(fdopen(fds[0], "rb"));
+    }
+
+    // Report in file order. Files a worker failed to compile or didn't get
+    // to, because it died or never started, are compiled by the normal pass
+    // afterwards.
+    vector<unique_ptr<reader>> readers;
+    for (FILE *fp : results)
+    {
+        readers.emplace_back(new reader(fp));
+        readers.back()->set_safe_read(true);
+    }
+    vector<bool> worker_ok(results.size(), true);
+    for (int i : stale)
+    {
+        const int job = owner[i];
+        if (job >= (int) readers.size() || !worker_ok[job])
+            continue;
+        try
+        {
+            reader &th = *readers[job];
+            if (unmarshallInt(th) != i)
+                throw short_read_exception();
+            const int64_t usecs = unmarshallSigned(th);
+            if (usecs >= 0)
+                _report_compile_time(files[i], usecs);
+        }
+        catch (short_read_exception &E)
+        {
+            worker_ok[job] = false;
+        }
+    }
+
+    readers.clear();
+    for (unsigned int job = 0; job < pids.size(); ++job)
+    {
+        fclose(results[job]);
+        waitpid(pids[job], nullptr, 0);
+    }
 }
+#endif
 
 void read_map(const string &file)
 {
+    if (des_files_wanted)
+    {
+        des_files_wanted->push_back(datafile_path(file));
+        return;
+    }
+
     _parse_maps(lc_desfile = datafile_path(file));
     _dgn_flush_map_environments();
     // Force GC to prevent heap from swelling unnecessarily.
@@ -1468,9 +2160,27 @@ void read_map(const string &file)
 
 void read_maps()
 {
+    if (SysEnv.vault_db)
+        _open_vault_db();
+
+#ifdef UNIX
+    // -dump-maps output from several workers would be interleaved.
+    if (crawl_state.build_db && SysEnv.jobs > 1 && !crawl_state.dump_maps)
+        _compile_maps_parallel();
+#endif
+
     if (dlua.execfile("dlua/loadmaps.lua", true, true, true))
         end(1, false, "Lua error: %s", dlua.error.c_str());
 
+    if (SysEnv.vault_db)
+    {
+        // Leftover files were removed, or renamed, since it was written.
+        if (vault_db.stale || !vault_db.files.empty())
+            _write_vault_db();
+        vault_db.files.clear();
+        vault_db.loaded.clear();
+    }
+
     lc_loaded_maps.clear();
 
     {
@@ -1494,6 +2204,7 @@ void reread_maps()
 
     // BOOM!
     vdefs.clear();
+    _invalidate_vault_index();
     map_files_read.clear();
     read_maps();
 }
@@ -1513,6 +2224,7 @@ void add_parsed_map(const map_def &md)
 
     map.fixup();
     vdefs.push_back(map);
+    _invalidate_vault_index();
 }
 
 void run_map_global_preludes()
@@ -1541,6 +2253,8 @@ void run_map_local_preludes()
             }
         }
     }
+    // The preludes may have changed tags.
+    _invalidate_vault_index();
 }
 
 const map_def *map_by_index(int index)
@@ -1100,7 +1100,7 @@ bool mon_special_ability(monster* mons)
         // Otherwise, if our foe is approaching us, we might want to raise a
         // defensive wall of brambles (use the number of brambles in the area
         // as some indication if we've already done this, and shouldn't repeat)
-        else if (mons->props["foe_approaching"].get_bool() == true
+        else if (mons->props[FOE_APPROACHING_KEY].get_bool() == true
                  && !mons_is_confused(*mons)
                  && coinflip())
         {
@@ -1410,9 +1410,9 @@ static void _pre_monster_move(monster& mons)
     switch (mons.type)
     {
     case MONS_SNAPLASHER_VINE:
-        if (mons.props.exists("vine_awakener"))
+        if (mons.props.exists(VINE_AWAKENER_KEY))
         {
-            monster* awakener = monster_by_mid(mons.props["vine_awakener"].get_int());
+            monster* awakener = monster_by_mid(mons.props[VINE_AWAKENER_KEY].get_int());
             if (awakener && !awakener->can_see(mons))
             {
                 simple_monster_message(mons, " falls limply to the ground.");
@@ -1464,23 +1464,23 @@ static void _pre_monster_move(monster& mons)
         actor* foe = mons.get_foe();
         if (foe)
         {
-            if (!mons.props.exists("foe_pos"))
-                mons.props["foe_pos"].get_coord() = foe->pos();
+            if (!mons.props.exists(FOE_POS_KEY))
+                mons.props[FOE_POS_KEY].get_coord() = foe->pos();
             else
             {
-                if (mons.props["foe_pos"].get_coord().distance_from(mons.pos())
+                if (mons.props[FOE_POS_KEY].get_coord().distance_from(mons.pos())
                     > foe->pos().distance_from(mons.pos()))
                 {
-                    mons.props["foe_approaching"].get_bool() = true;
+                    mons.props[FOE_APPROACHING_KEY].get_bool() = true;
                 }
                 else
-                    mons.props["foe_approaching"].get_bool() = false;
+                    mons.props[FOE_APPROACHING_KEY].get_bool() = false;
 
-                mons.props["foe_pos"].get_coord() = foe->pos();
+                mons.props[FOE_POS_KEY].get_coord() = foe->pos();
             }
         }
         else
-            mons.props.erase("foe_pos");
+            mons.props.erase(FOE_POS_KEY);
     }
 
     reset_battlesphere(&mons);
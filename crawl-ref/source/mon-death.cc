@@ -2624,10 +2624,10 @@ item_def* monster_die(monster& mons, killer_type killer,
     {
         if (mons.type == MONS_SNAPLASHER_VINE)
         {
-            if (mons.props.exists("vine_awakener"))
+            if (mons.props.exists(VINE_AWAKENER_KEY))
             {
                 monster* awakener =
-                        monster_by_mid(mons.props["vine_awakener"].get_int());
+                        monster_by_mid(mons.props[VINE_AWAKENER_KEY].get_int());
                 if (awakener)
                     awakener->props["vines_awakened"].get_int()--;
             }
@@ -2822,8 +2822,8 @@ void unawaken_vines(const monster* mons, bool quiet)
     for (monster_iterator mi; mi; ++mi)
     {
         if (mi->type == MONS_SNAPLASHER_VINE
-            && mi->props.exists("vine_awakener")
-            && monster_by_mid(mi->props["vine_awakener"].get_int()) == mons)
+            && mi->props.exists(VINE_AWAKENER_KEY)
+            && monster_by_mid(mi->props[VINE_AWAKENER_KEY].get_int()) == mons)
         {
             if (you.can_see(**mi))
                 ++vines_seen;
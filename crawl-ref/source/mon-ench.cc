@@ -1243,13 +1243,13 @@ static void _merfolk_avatar_song(monster* mons)
     {
         // Don't pull the player if they walked forward voluntarily this
         // turn (to avoid making you jump two spaces at once)
-        if (!mons->props["foe_approaching"].get_bool())
+        if (!mons->props[FOE_APPROACHING_KEY].get_bool())
         {
             _merfolk_avatar_movement_effect(mons);
 
             // Reset foe tracking position so that we won't automatically
             // veto pulling on a subsequent turn because you 'approached'
-            mons->props["foe_pos"].get_coord() = you.pos();
+            mons->props[FOE_POS_KEY].get_coord() = you.pos();
         }
     }
 
@@ -19,16 +19,50 @@
 // The pathfinding is an implementation of the A* algorithm. Beginning at the
 // monster position we check all neighbours of a given grid, estimate the
 // distance needed for any shortest path including this grid and push the
-// result into a hash. We can then easily access all points with the shortest
-// distance estimates and then check _their_ neighbours and so on.
+// result onto a heap. We can then easily access the point with the shortest
+// distance estimate and then check _its_ neighbours and so on.
 // The algorithm terminates once we reach the destination since - because
-// of the sorting of grids by shortest distance in the hash - there can be no
+// of the sorting of grids by shortest distance in the heap - there can be no
 // path between start and target that is shorter than the current one. There
 // could be other paths that have the same length but that has no real impact.
-// If the hash has been cleared and the start grid has not been encountered,
+// If the heap has been emptied and the start grid has not been encountered,
 // then there's no path that matches the requirements fed into monster_pathfind.
 // (These requirements are usually preference of habitat of a specific monster
 // or a limit of the distance between start and any grid on the path.)
+//
+// Many monsters look for paths every turn, so rather than clearing a full
+// level's worth of distances for every search, all searches share the grids
+// below. Each search takes a new generation, and any entry stamped with an
+// older generation counts as unset. This means only the most recent search's
+// path can be backtracked.
+static struct
+{
+    unsigned int generation;
+
+    // Distance from start, and the direction we came from, for points
+    // whose dist_stamp is the current generation.
+    unsigned int dist_stamp[GXM][GYM];
+    int dist[GXM][GYM];
+    int prev[GXM][GYM];
+
+    // Memoized traversable() for points whose traversable_stamp is the
+    // current generation.
+    unsigned int traversable_stamp[GXM][GYM];
+    bool traversable[GXM][GYM];
+} _scratch;
+
+static unsigned int _new_scratch_generation()
+{
+    if (++_scratch.generation == 0)
+    {
+        // Wrapped around: make sure nothing looks current.
+        memset(_scratch.dist_stamp, 0, sizeof(_scratch.dist_stamp));
+        memset(_scratch.traversable_stamp, 0,
+               sizeof(_scratch.traversable_stamp));
+        _scratch.generation = 1;
+    }
+    return _scratch.generation;
+}
 
 int mons_tracking_range(const monster* mon)
 {
@@ -66,8 +100,7 @@ int mons_tracking_range(const monster* mon)
 //#define DEBUG_PATHFIND
 monster_pathfind::monster_pathfind()
     : mons(nullptr), start(), target(), pos(), allow_diagonals(true),
-      traverse_unmapped(false), range(0), min_length(0), max_length(0),
-      dist(), prev(), hash(), traversable_cache()
+      traverse_unmapped(false), range(0), open(), open_seq(0), generation(0)
 {
 }
 
@@ -83,7 +116,8 @@ void monster_pathfind::set_range(int r)
 
 coord_def monster_pathfind::next_pos(const coord_def &c) const
 {
-    return c + Compass[prev[c.x][c.y]];
+    ASSERT(generation == _scratch.generation);
+    return c + Compass[_scratch.prev[c.x][c.y]];
 }
 
 // The main method in the monster_pathfind class.
@@ -138,21 +172,18 @@ bool monster_pathfind::start_pathfind(bool msg)
     //       surrounded by shallow water or floor, or if a foe is hiding in
     //       a wall.
 
-    max_length = min_length = grid_distance(pos, target);
-    for (int i = 0; i < GXM; i++)
-        for (int j = 0; j < GYM; j++)
-        {
-            dist[i][j] = INFINITE_DISTANCE;
-            traversable_cache[i][j] = MB_MAYBE;
-        }
+    generation = _new_scratch_generation();
+    open.clear();
+    open_seq = 0;
 
-    dist[pos.x][pos.y] = 0;
+    _scratch.dist_stamp[pos.x][pos.y] = generation;
+    _scratch.dist[pos.x][pos.y] = 0;
 
     bool success = false;
     do
     {
         // Calculate the distance to all neighbours of the current position,
-        // and add them to the hash, if they haven't already been looked at.
+        // and add them to the heap, if they haven't already been looked at.
         success = calc_path_to_neighbours();
         if (success)
             return true;
@@ -216,8 +247,8 @@ bool monster_pathfind::calc_path_to_neighbours()
         if (range && estimated_cost(npos) > range)
             continue;
 
-        distance = dist[pos.x][pos.y] + travel_cost(npos);
-        old_dist = dist[npos.x][npos.y];
+        distance = dist_to(pos) + travel_cost(npos);
+        old_dist = dist_to(npos);
 
         // Also bail out if this would make the path longer than twice the
         // allowed distance from the target. (This factor may need tuning.)
@@ -233,33 +264,22 @@ bool monster_pathfind::calc_path_to_neighbours()
              INFINITE_DISTANCE);
 #endif
         // If the new distance is better than the old one (initialised with
-        // INFINITE), update the position.
+        // INFINITE), update the position. An improved position's old heap
+        // entry is left behind, and skipped by get_best_position().
         if (distance < old_dist)
         {
             // Calculate new total path length.
             total = distance + estimated_cost(npos);
-            if (old_dist == INFINITE_DISTANCE)
-            {
-#ifdef DEBUG_PATHFIND
-                mprf("Adding (%d,%d) to hash (total dist = %d)",
-                     npos.x, npos.y, total);
-#endif
-                add_new_pos(npos, total);
-                if (total > max_length)
-                    max_length = total;
-            }
-            else
-            {
 #ifdef DEBUG_PATHFIND
-                mprf("Improving (%d,%d) to total dist %d",
-                     npos.x, npos.y, total);
+            mprf("%s (%d,%d) with total dist %d",
+                 old_dist == INFINITE_DISTANCE ? "Adding" : "Improving",
+                 npos.x, npos.y, total);
 #endif
-
-                update_pos(npos, total);
-            }
+            add_new_pos(npos, total);
 
             // Update distance start->pos.
-            dist[npos.x][npos.y] = distance;
+            _scratch.dist_stamp[npos.x][npos.y] = generation;
+            _scratch.dist[npos.x][npos.y] = distance;
 
             // Set backtracking information.
             // Converts the Compass direction to its counterpart.
@@ -267,7 +287,7 @@ bool monster_pathfind::calc_path_to_neighbours()
             //      7  .  3   ==>   3  .  7       e.g. (3 + 4) % 8          = 7
             //      6  5  4         2  1  0            (7 + 4) % 8 = 11 % 8 = 3
 
-            prev[npos.x][npos.y] = (dir + 4) % 8;
+            _scratch.prev[npos.x][npos.y] = (dir + 4) % 8;
 
             // Are we finished?
             if (npos == target)
@@ -282,34 +302,32 @@ bool monster_pathfind::calc_path_to_neighbours()
     return false;
 }
 
-// Starting at known min_length (minimum total estimated path distance), check
-// the hash for existing vectors, then pick the last entry of the first vector
-// that matches. Update min_length, if necessary.
+// Orders the open heap: a comes after b if its estimate is longer, or if it
+// is as long but was added earlier.
+bool monster_pathfind::open_pos_after(const open_pos &a, const open_pos &b)
+{
+    return a.total > b.total || (a.total == b.total && a.seq < b.seq);
+}
+
+// Pick the open position with the shortest total estimated path distance.
 bool monster_pathfind::get_best_position()
 {
-    for (int i = min_length; i <= max_length; i++)
+    while (!open.empty())
     {
-        if (!hash[i].empty())
-        {
-            if (i > min_length)
-                min_length = i;
-
-            vector<coord_def> &vec = hash[i];
-            // Pick the last position pushed into the vector as it's most
-            // likely to be close to the target.
-            pos = vec[vec.size()-1];
-            vec.pop_back();
+        pop_heap(open.begin(), open.end(), open_pos_after);
+        const open_pos best = open.back();
+        open.pop_back();
 
-#ifdef DEBUG_PATHFIND
-            mprf("Returning (%d, %d) as best pos with total dist %d.",
-                 pos.x, pos.y, min_length);
-#endif
+        // Skip entries of positions that have been improved since.
+        if (best.total != dist_to(best.pos) + estimated_cost(best.pos))
+            continue;
 
-            return true;
-        }
+        pos = best.pos;
 #ifdef DEBUG_PATHFIND
-        mprf("No positions for path length %d.", i);
+        mprf("Returning (%d, %d) as best pos with total dist %d.",
+             pos.x, pos.y, best.total);
 #endif
+        return true;
     }
 
     // Nothing found? Then there's no path! :(
@@ -330,10 +348,11 @@ vector<coord_def> monster_pathfind::backtrack()
     if (pos == start)
         return path;
 
+    ASSERT(generation == _scratch.generation);
     int dir;
     do
     {
-        dir = prev[pos.x][pos.y];
+        dir = _scratch.prev[pos.x][pos.y];
         pos = pos + Compass[dir];
         ASSERT_IN_BOUNDS(pos);
 #ifdef DEBUG_PATHFIND
@@ -397,9 +416,12 @@ vector<coord_def> monster_pathfind::calc_waypoints()
 
 bool monster_pathfind::traversable_memoized(const coord_def& p)
 {
-    if (traversable_cache[p.x][p.y] == MB_MAYBE)
-        traversable_cache[p.x][p.y] = frombool(traversable(p));
-    return tobool(traversable_cache[p.x][p.y], false);
+    if (_scratch.traversable_stamp[p.x][p.y] != generation)
+    {
+        _scratch.traversable[p.x][p.y] = traversable(p);
+        _scratch.traversable_stamp[p.x][p.y] = generation;
+    }
+    return _scratch.traversable[p.x][p.y];
 }
 
 bool monster_pathfind::traversable(const coord_def& p)
@@ -509,26 +531,14 @@ int monster_pathfind::estimated_cost(coord_def p)
     return grid_distance(p, target);
 }
 
-void monster_pathfind::add_new_pos(coord_def npos, int total)
+int monster_pathfind::dist_to(const coord_def &p) const
 {
-    hash[total].push_back(npos);
+    return _scratch.dist_stamp[p.x][p.y] == generation ? _scratch.dist[p.x][p.y]
+                                                       : INFINITE_DISTANCE;
 }
 
-void monster_pathfind::update_pos(coord_def npos, int total)
+void monster_pathfind::add_new_pos(coord_def npos, int total)
 {
-    // Find hash position of old distance and delete it,
-    // then call_add_new_pos.
-    int old_total = dist[npos.x][npos.y] + estimated_cost(npos);
-
-    vector<coord_def> &vec = hash[old_total];
-    for (unsigned int i = 0; i < vec.size(); i++)
-    {
-        if (vec[i] == npos)
-        {
-            vec.erase(vec.begin() + i);
-            break;
-        }
-    }
-
-    add_new_pos(npos, total);
+    open.push_back({total, open_seq++, npos});
+    push_heap(open.begin(), open.end(), open_pos_after);
 }
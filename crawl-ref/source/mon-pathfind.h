@@ -1,9 +1,6 @@
 #pragma once
 
 #include "defines.h"
-#include "fixedvector.h"
-#include "maybe-bool.h"
-#include <unordered_map>
 #include <vector>
 
 using std::vector;
@@ -39,8 +36,8 @@ protected:
     bool mons_traversable(const coord_def& p);
     int  mons_travel_cost(coord_def npos);
     int  estimated_cost(coord_def npos);
+    int  dist_to(const coord_def &p) const;
     void add_new_pos(coord_def pos, int total);
-    void update_pos(coord_def pos, int total);
     bool get_best_position();
 
     // The monster trying to find a path.
@@ -64,16 +61,24 @@ protected:
     // Maximum range to search between start and target. None, if zero.
     int range;
 
-    // Currently shortest and longest possible total length of the path.
-    int min_length;
-    int max_length;
-
-    // The array of distances from start to any already tried point.
-    int dist[GXM][GYM];
-    // An array to store where we came from on a given shortest path.
-    int prev[GXM][GYM];
-
-    FixedVector<vector<coord_def>, GXM * GYM> hash;
-
-    maybe_bool traversable_cache[GXM][GYM];
+    // A position waiting to be looked at, with its estimated total path
+    // length.
+    struct open_pos
+    {
+        int total;
+        unsigned int seq;
+        coord_def pos;
+    };
+    static bool open_pos_after(const open_pos &a, const open_pos &b);
+
+    // Binary heap of positions to look at: shortest estimate first, and
+    // among those the most recently added (it's most likely to be close to
+    // the target).
+    vector<open_pos> open;
+    unsigned int open_seq;
+
+    // Distances, backtracking information and traversability are kept in
+    // grids shared by all pathfinders (see mon-pathfind.cc); this is the
+    // generation of those grids that belongs to our search.
+    unsigned int generation;
 };
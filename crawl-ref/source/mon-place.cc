@@ -829,6 +829,7 @@ monster* get_free_monster()
         if (mons.type == MONS_NO_MONSTER)
         {
             mons.reset();
+            mons_index_add(mons);
             return &mons;
         }
 
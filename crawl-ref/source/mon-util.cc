@@ -9,6 +9,7 @@
 
 #include <algorithm>
 #include <cmath>
+#include <functional>
 #include <sstream>
 
 #include "act-iter.h"
@@ -5261,6 +5262,159 @@ void reset_all_monsters()
     env.mid_cache.clear();
 }
 
+// The monster index: env.mons_slots lists every occupied menv slot (and
+// possibly a few freed ones, since a slot is only dropped when reset), in
+// order, and env.mons_buckets holds the same slots by position. Anything
+// that takes a free slot goes through get_free_monster() or a level load,
+// and monsters move through set_position(), so those are the only places
+// that need to keep it up to date.
+
+// Monsters outside menv (copies, mirrors, and so on) have no slot. Pointer
+// subtraction across arrays is undefined, so check the bounds with
+// std::less, which gives a total order, before taking the difference.
+static int _mons_index_slot(const monster &mon)
+{
+    const monster *first = menv.buffer();
+    const less<const monster *> before;
+    if (before(&mon, first) || !before(&mon, first + MAX_MONSTERS))
+        return -1;
+    return &mon - first;
+}
+
+static coord_def _mons_bucket(const coord_def &p)
+{
+    return coord_def(p.x / MONS_BUCKET_SIZE, p.y / MONS_BUCKET_SIZE);
+}
+
+static void _sorted_insert(vector<int> &v, int i)
+{
+    auto it = lower_bound(v.begin(), v.end(), i);
+    if (it == v.end() || *it != i)
+        v.insert(it, i);
+}
+
+static void _sorted_erase(vector<int> &v, int i)
+{
+    auto it = lower_bound(v.begin(), v.end(), i);
+    if (it != v.end() && *it == i)
+        v.erase(it);
+}
+
+static void _mons_index_file(int i)
+{
+    const coord_def p = menv[i].pos();
+    if (!map_bounds(p))
+    {
+        env.mons_bucket_of[i] = coord_def(-1, -1);
+        return;
+    }
+    env.mons_bucket_of[i] = _mons_bucket(p);
+    _sorted_insert(env.mons_buckets(env.mons_bucket_of[i]), i);
+}
+
+static void _mons_index_unfile(int i)
+{
+    const coord_def b = env.mons_bucket_of[i];
+    if (b.x >= 0 && b.y >= 0)
+        _sorted_erase(env.mons_buckets(b), i);
+    env.mons_bucket_of[i] = coord_def(-1, -1);
+}
+
+static bool _mons_index_has(int i)
+{
+    return binary_search(env.mons_slots.begin(), env.mons_slots.end(), i);
+}
+
+void mons_index_add(const monster &mon)
+{
+    const int i = _mons_index_slot(mon);
+    if (i < 0)
+        return;
+    _sorted_insert(env.mons_slots, i);
+    _mons_index_unfile(i);
+    _mons_index_file(i);
+}
+
+void mons_index_remove(const monster &mon)
+{
+    const int i = _mons_index_slot(mon);
+    if (i < 0)
+        return;
+    _sorted_erase(env.mons_slots, i);
+    _mons_index_unfile(i);
+}
+
+// Refile the monster under its current position.
+void mons_index_moved(const monster &mon)
+{
+    const int i = _mons_index_slot(mon);
+    if (i < 0 || !_mons_index_has(i))
+        return;
+
+    const coord_def p = mon.pos();
+    if (map_bounds(p) && env.mons_bucket_of[i] == _mons_bucket(p))
+        return;
+    _mons_index_unfile(i);
+    _mons_index_file(i);
+}
+
+/**
+ * Is the monster in the index, under the right position?
+ * Used by debug_mons_scan().
+ */
+bool mons_index_valid(const monster &mon)
+{
+    const int i = _mons_index_slot(mon);
+    if (i < 0)
+        return true;
+    if (!_mons_index_has(i))
+        return false;
+    if (!map_bounds(mon.pos()))
+        return true;
+    const vector<int> &bucket = env.mons_buckets(_mons_bucket(mon.pos()));
+    return binary_search(bucket.begin(), bucket.end(), i);
+}
+
+/**
+ * The next slot in the monster index after the given one.
+ *
+ * @param after  The slot to start after; -1 to start from the beginning.
+ * @return       The slot, or MAX_MONSTERS if there are no more.
+ */
+int mons_index_next(int after)
+{
+    auto it = upper_bound(env.mons_slots.begin(), env.mons_slots.end(), after);
+    return it == env.mons_slots.end() ? MAX_MONSTERS : *it;
+}
+
+/**
+ * The next slot in the monster index after the given one, whose monster
+ * might be within the given range (as rdist) of a position. Monsters that
+ * are further away may be returned too, so callers must still check.
+ *
+ * @param c      The centre of the area.
+ * @param range  The greatest rdist of interest.
+ * @param after  The slot to start after; -1 to start from the beginning.
+ * @return       The slot, or MAX_MONSTERS if there are no more.
+ */
+int mons_index_next_near(const coord_def &c, int range, int after)
+{
+    const coord_def lo = _mons_bucket(coord_def(max(c.x - range, 0),
+                                                max(c.y - range, 0)));
+    const coord_def hi = _mons_bucket(coord_def(min(c.x + range, GXM - 1),
+                                                min(c.y + range, GYM - 1)));
+    int next = MAX_MONSTERS;
+    for (int x = lo.x; x <= hi.x; ++x)
+        for (int y = lo.y; y <= hi.y; ++y)
+        {
+            const vector<int> &bucket = env.mons_buckets[x][y];
+            auto it = upper_bound(bucket.begin(), bucket.end(), after);
+            if (it != bucket.end() && *it < next)
+                next = *it;
+        }
+    return next;
+}
+
 bool mons_is_recallable(const actor* caller, const monster& targ)
 {
     // For player, only recall friendly monsters
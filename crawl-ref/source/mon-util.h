@@ -518,6 +518,12 @@ bool mons_is_player_shadow(const monster& mon);
 bool mons_has_attacks(const monster& mon);
 
 void reset_all_monsters();
+void mons_index_add(const monster &mon);
+void mons_index_remove(const monster &mon);
+void mons_index_moved(const monster &mon);
+bool mons_index_valid(const monster &mon);
+int mons_index_next(int after);
+int mons_index_next_near(const coord_def &c, int range, int after);
 void debug_mondata();
 void debug_monspells();
 
@@ -145,6 +145,7 @@ void monster::reset()
     unseen_pos = coord_def(0, 0);
 
     mons_remove_from_grid(*this);
+    mons_index_remove(*this);
     target.reset();
     position.reset();
     firing_pos.reset();
@@ -207,6 +208,10 @@ void monster::init_with(const monster& mon)
         ghost.reset(new ghost_demon(*mon.ghost));
     else
         ghost.reset(nullptr);
+
+    // reset() dropped us from the monster index.
+    if (type != MONS_NO_MONSTER)
+        mons_index_add(*this);
 }
 
 uint32_t monster::last_client_id = 0;
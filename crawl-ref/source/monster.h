@@ -18,7 +18,7 @@ const int KRAKEN_TENTACLE_RANGE = 3;
 #define MAX_DAMAGE_COUNTER 10000
 #define ZOMBIE_BASE_AC_KEY "zombie_base_ac"
 #define ZOMBIE_BASE_EV_KEY "zombie_base_ev"
-#define MON_SPEED_KEY "speed"
+static constexpr store_key MON_SPEED_KEY("speed");
 #define CUSTOM_SPELLS_KEY "custom_spells"
 #define SEEN_SPELLS_KEY "seen_spells"
 #define KNOWN_MAX_HP_KEY "known_max_hp"
@@ -34,6 +34,11 @@ const int KRAKEN_TENTACLE_RANGE = 3;
 
 #define MAP_KEY "map"
 
+// Looked at every turn by _pre_monster_move().
+static constexpr store_key FOE_POS_KEY("foe_pos");
+static constexpr store_key FOE_APPROACHING_KEY("foe_approaching");
+static constexpr store_key VINE_AWAKENER_KEY("vine_awakener");
+
 typedef map<enchant_type, mon_enchant> mon_enchant_list;
 
 struct monsterentry;
@@ -108,7 +108,8 @@ public:
     // Propagate noise from the noise sources registered.
     void propagate_noise();
 
-    // Clear all noise from the noise grid.
+    // Clear all noise from the noise grid. Only the cells noise has
+    // reached are touched.
     void reset();
 
     bool dirty() const { return !noises.empty(); }
@@ -120,6 +121,9 @@ public:
 #endif
 
 private:
+    void apply_noise_to_cell(const coord_def &pos, int noise_intensity_millis,
+                             int noise_id, int travel_distance,
+                             const coord_def &neighbour_delta);
     bool propagate_noise_to_neighbour(int base_attenuation,
                                       int travel_distance,
                                       const noise_cell &cell,
@@ -136,6 +140,15 @@ private:
 
 private:
     FixedArray<noise_cell, GXM, GYM> cells;
+    // Cells that have had noise applied since the last reset().
+    vector<coord_def> touched_cells;
+    // The current and next distance layers of propagate_noise()'s sweep,
+    // kept between calls to save reallocating them.
+    vector<coord_def> noise_perimeter[2];
     vector<noise_t> noises;
     int affected_actor_count;
 };
+
+#ifdef DEBUG_NOISE_PROFILING
+void noise_profile_out();
+#endif
@@ -173,6 +173,7 @@ public:
     uint64_t    seed;           // Non-random games.
     uint64_t    seed_from_rc;
     bool        pregen_dungeon; // Is the dungeon generated at the beginning?
+    bool        pregen_background; // ... or while the game is being played?
 
 #ifdef DGL_SIMPLE_MESSAGING
     bool        messaging;      // Check for messages.
@@ -16,6 +16,8 @@ Notes:
 * Readers always get the last complete (but not necessarily committed) write
   (ie, READ_UNCOMMITTED) at the time they started; it is safe to continue
   reading even if the chunk has been changed since.
+* Nothing is written until a chunk_writer is closed. Rewriting a chunk with
+  the contents it already has writes nothing and doesn't need a commit.
 */
 
 #include "AppHdr.h"
@@ -26,7 +28,11 @@ Notes:
 #include <cstdlib>
 #include <cstring>
 #include <sstream>
+#include <chrono>
 #include <fcntl.h>
+#ifdef USE_MMAP
+#include <sys/mman.h>
+#endif
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <unistd.h>
@@ -57,7 +63,7 @@ static plen_t htole(plen_t x)
 #define dprintf(...) do {} while (0)
 #endif
 
-#define PACKAGE_VERSION 1
+#define PACKAGE_VERSION 2
 #define PACKAGE_MAGIC   0x53534344 /* "DCSS" */
 
 struct file_header
@@ -79,11 +85,17 @@ typedef pair<plen_t, plen_t> bm_p;
 typedef map<plen_t, bm_p> bm_t;
 typedef map<plen_t, plen_t> fb_t;
 
+bool package::use_mmap = true;
+
 package::package(const char* file, bool writeable, bool empty)
-  : n_users(0), dirty(false), aborted(false)
+  : n_users(0), dirty(false), aborted(false), bytes_written(0),
+    last_commit_bytes(0), chunks_skipped(0), read_stats()
 #ifdef DO_FSYNC
     , tmp(false)
 #endif
+#ifdef USE_MMAP
+    , map_data(nullptr), map_len(0), map_failed(false)
+#endif
 {
     dprintf("package: initializing file=\"%s\" rw=%d\n", file, writeable);
     ASSERT(writeable || !empty);
@@ -130,10 +142,14 @@ package::package(const char* file, bool writeable, bool empty)
 }
 
 package::package()
-  : rw(true), n_users(0), dirty(false), aborted(false)
+  : rw(true), n_users(0), dirty(false), aborted(false), bytes_written(0),
+    last_commit_bytes(0), chunks_skipped(0), read_stats()
 #ifdef DO_FSYNC
     , tmp(true)
 #endif
+#ifdef USE_MMAP
+    , map_data(nullptr), map_len(0), map_failed(false)
+#endif
 {
     dprintf("package: initializing tmp file\n");
     filename = "[tmp]";
@@ -212,6 +228,10 @@ package::~package()
         // catching missing manual deletes. The C++ exit handler is the
         // only place that can be legitimately call things in wrong order.
 
+    // Must come before truncating, touching pages past the end of the file
+    // is fatal.
+    unmap();
+
     if (rw && !aborted)
     {
         commit();
@@ -233,7 +253,10 @@ void package::commit()
 {
     ASSERT(rw);
     if (!dirty)
+    {
+        last_commit_bytes = 0;
         return;
+    }
     ASSERT(!aborted);
 
 #ifdef COSTLY_ASSERTS
@@ -253,6 +276,7 @@ void package::commit()
     seek(0);
     if (write(fd, &head, sizeof(head)) != sizeof(head))
         sysfail("write error while saving");
+    bytes_written += sizeof(head);
 #ifdef DO_FSYNC
     if (!tmp && fdatasync(fd))
         sysfail("flush error while saving");
@@ -261,12 +285,69 @@ void package::commit()
     new_chunks.clear();
     collect_blocks();
     dirty = false;
+    dprintf("package: committed %u bytes\n", bytes_written);
+    last_commit_bytes = bytes_written;
+    bytes_written = 0;
 
 #ifdef COSTLY_ASSERTS
     fsck();
 #endif
 }
 
+/**
+ * Make sure the whole file is mapped into memory, remapping it if it has
+ * grown since it was last mapped. The old mapping is only dropped once the
+ * new one is in place.
+ *
+ * @return false if the file can't be mapped, in which case chunks have to be
+ *         read with read() instead.
+ */
+bool package::update_map()
+{
+#ifdef USE_MMAP
+    if (!use_mmap || map_failed || fd == -1 || !file_len)
+        return false;
+    if (map_data && map_len >= file_len)
+        return true;
+
+    void *data = mmap(nullptr, file_len, PROT_READ, MAP_SHARED, fd, 0);
+    if (data == MAP_FAILED)
+    {
+        dprintf("package: can't map %s, falling back to read()\n",
+                filename.c_str());
+        // Keep any old mapping: readers that started on it still use it,
+        // and their chunks all lie within it.
+        map_failed = true;
+        return false;
+    }
+    unmap();
+    map_data = (const char*)data;
+    map_len = file_len;
+    return true;
+#else
+    return false;
+#endif
+}
+
+void package::unmap()
+{
+#ifdef USE_MMAP
+    if (map_data)
+        munmap((void*)map_data, map_len);
+    map_data = nullptr;
+    map_len = 0;
+#endif
+}
+
+bool package::is_mapped() const
+{
+#ifdef USE_MMAP
+    return map_data;
+#else
+    return false;
+#endif
+}
+
 void package::seek(plen_t to)
 {
     ASSERT(!aborted);
@@ -275,11 +356,12 @@ void package::seek(plen_t to)
         corrupted("save file corrupted -- invalid offset");
     if (lseek(fd, to, SEEK_SET) != (off_t)to)
         sysfail("failed to seek inside the save file");
+    read_stats.syscalls++;
 }
 
-chunk_writer* package::writer(const string &name)
+chunk_writer* package::writer(const string &name, chunk_codec codec)
 {
-    return new chunk_writer(this, name);
+    return new chunk_writer(this, name, codec);
 }
 
 chunk_reader* package::reader(const string &name)
@@ -380,6 +462,40 @@ void package::free_chunk(const string &name)
     dirty = true;
 }
 
+/**
+ * Would writing `data` as chunk `name` leave the save as it is?
+ *
+ * Chunks are only compared if their digests match, so this is cheap for
+ * chunks that did change. Chunks that haven't been written or fully read
+ * since the package was opened have no digest, and are never considered
+ * unchanged.
+ */
+bool package::chunk_unchanged(const string &name, chunk_codec codec,
+                              const chunk_digest &digest,
+                              const vector<char> &data)
+{
+    plen_t *start = map_find(directory, name);
+    if (!start)
+        return false;
+    if (lookup(codecs, *start, CODEC_ZLIB) != codec)
+        return false;
+    chunk_digest *old = map_find(digests, *start);
+    if (!old || !(*old == digest))
+        return false;
+
+    // The digest only makes a match very likely; make sure.
+    chunk_reader rd(this, *start);
+    char buf[16384];
+    plen_t at = 0;
+    while (plen_t s = rd.read(buf, sizeof(buf)))
+    {
+        if (at + s > data.size() || memcmp(buf, &data[at], s))
+            return false;
+        at += s;
+    }
+    return at == data.size();
+}
+
 void package::delete_chunk(const string &name)
 {
     free_chunk(name);
@@ -398,6 +514,8 @@ plen_t package::write_directory()
         dir.write(&entry.first[0], entry.first.length());
         plen_t start = htole(entry.second);
         dir.write((const char*)&start, sizeof(plen_t));
+        uint8_t codec = lookup(codecs, entry.second, CODEC_ZLIB);
+        dir.write((const char*)&codec, sizeof(codec));
     }
 
     ASSERT(dir.str().size());
@@ -433,6 +551,8 @@ void package::free_block_chain(plen_t at)
     }
 
     dprintf("freeing an unlinked chain at %d\n", at);
+    digests.erase(at);
+    codecs.erase(at);
     while (at)
     {
         auto bl = block_map.find(at);
@@ -538,6 +658,7 @@ void package::read_directory(plen_t start, uint8_t version)
         }
         break;
     case 1:
+    case 2:
         uint8_t name_len;
         plen_t bstart;
         while (plen_t res = rd.read(&name_len, sizeof(name_len)))
@@ -551,6 +672,20 @@ void package::read_directory(plen_t start, uint8_t version)
             if (rd.read(&bstart, sizeof(bstart)) != sizeof(bstart))
                 corrupted("save file corrupted -- truncated directory");
             directory[chname] = htole(bstart);
+            // Version 1 has no codecs, everything is CODEC_ZLIB.
+            if (version >= 2)
+            {
+                uint8_t codec;
+                if (rd.read(&codec, sizeof(codec)) != sizeof(codec))
+                    corrupted("save file corrupted -- truncated directory");
+                if (codec >= NUM_CODECS)
+                {
+                    corrupted("save file (%s) uses an unknown codec %u",
+                              filename.c_str(), codec);
+                }
+                if (codec != CODEC_ZLIB)
+                    codecs[htole(bstart)] = static_cast<chunk_codec>(codec);
+            }
             dprintf("* %s\n", chname.c_str());
         }
         break;
@@ -565,6 +700,28 @@ bool package::has_chunk(const string &name)
     return !name.empty() && directory.count(name);
 }
 
+chunk_codec package::get_chunk_codec(const string &name)
+{
+    ASSERT(directory.count(name)); // not has_chunk(), "" is valid
+    return lookup(codecs, directory[name], CODEC_ZLIB);
+}
+
+/**
+ * Rewrite a chunk with a different codec. Its contents stay the same.
+ */
+void package::recompress_chunk(const string &name, chunk_codec codec)
+{
+    vector<char> data;
+    {
+        chunk_reader in(this, name);
+        in.read_all(data);
+    }
+
+    chunk_writer out(this, name, codec);
+    if (!data.empty())
+        out.write(&data[0], data.size());
+}
+
 vector<string> package::list_chunks()
 {
     vector<string> list;
@@ -623,6 +780,7 @@ void package::abort()
 void package::unlink()
 {
     abort();
+    unmap();
     close(fd);
     fd = -1;
     ::unlink_u(filename.c_str());
@@ -671,8 +829,9 @@ plen_t package::get_chunk_compressed_length(const string &name)
     return len;
 }
 
-chunk_writer::chunk_writer(package *parent, const string &_name)
-    : first_block(0), cur_block(0), block_len(0)
+chunk_writer::chunk_writer(package *parent, const string &_name,
+                           chunk_codec _codec)
+    : first_block(0), cur_block(0), block_len(0), codec(_codec)
 {
     ASSERT(parent);
     ASSERT(!parent->aborted);
@@ -685,18 +844,6 @@ chunk_writer::chunk_writer(package *parent, const string &_name)
     pkg = parent;
     pkg->n_users++;
     name = _name;
-
-#ifdef USE_ZLIB
-    zs.data_type = Z_BINARY;
-    zs.zalloc    = 0;
-    zs.zfree     = 0;
-    zs.opaque    = Z_NULL;
-    if (deflateInit(&zs, Z_DEFAULT_COMPRESSION))
-        fail("save file compression failed during init: %s", zs.msg);
-#define ZB_SIZE 32768
-    zs.next_out  = z_buffer = (Bytef*)malloc(ZB_SIZE);
-    zs.avail_out = ZB_SIZE;
-#endif
 }
 
 chunk_writer::~chunk_writer()
@@ -706,34 +853,71 @@ chunk_writer::~chunk_writer()
     ASSERT(pkg->n_users > 0);
     pkg->n_users--;
     if (pkg->aborted)
-    {
-#ifdef USE_ZLIB
-        // ignore errors, they're not relevant anymore
-        deflateEnd(&zs);
-        free(z_buffer);
-#endif
         return;
+
+    flush();
+}
+
+#ifdef USE_ZLIB
+static int _codec_level(chunk_codec codec)
+{
+    switch (codec)
+    {
+    case CODEC_ZLIB_FAST:
+        return Z_BEST_SPEED;
+    case CODEC_ZLIB_BEST:
+        return Z_BEST_COMPRESSION;
+    case CODEC_ZLIB:
+    default:
+        return Z_DEFAULT_COMPRESSION;
     }
+}
+#endif
 
+void chunk_writer::flush()
+{
 #ifdef USE_ZLIB
-    zs.avail_in = 0;
-    int res;
-    do
+    chunk_digest digest;
+    digest.crc = crc32(crc32(0, Z_NULL, 0), (const Bytef*)contents.data(),
+                       contents.size());
+    digest.len = contents.size();
+    if (pkg->chunk_unchanged(name, codec, digest, contents))
     {
-        res = deflate(&zs, Z_FINISH);
-        if (res != Z_STREAM_END && res != Z_OK && res != Z_BUF_ERROR)
-            fail("save file compression failed: %s", zs.msg);
-        raw_write(z_buffer, zs.next_out - z_buffer);
-        zs.next_out = z_buffer;
-        zs.avail_out = ZB_SIZE;
-    } while (res != Z_STREAM_END);
+        dprintf("chunk_writer(%s): unchanged, not rewriting\n", name.c_str());
+        pkg->chunks_skipped++;
+        return;
+    }
+
+    z_stream zs;
+    zs.data_type = Z_BINARY;
+    zs.zalloc    = 0;
+    zs.zfree     = 0;
+    zs.opaque    = Z_NULL;
+    if (deflateInit(&zs, _codec_level(codec)))
+        fail("save file compression failed during init: %s", zs.msg);
+
+    // Compress the whole chunk in one go, into a buffer big enough to hold
+    // any output, so that it gets written in as few pieces as possible.
+    vector<Bytef> z_buffer(deflateBound(&zs, contents.size()));
+    zs.next_in   = (Bytef*)contents.data();
+    zs.avail_in  = contents.size();
+    zs.next_out  = z_buffer.data();
+    zs.avail_out = z_buffer.size();
+    if (deflate(&zs, Z_FINISH) != Z_STREAM_END)
+        fail("save file compression failed: %s", zs.msg);
+    raw_write(z_buffer.data(), zs.next_out - z_buffer.data());
     if (deflateEnd(&zs) != Z_OK)
         fail("save file compression failed during clean-up: %s", zs.msg);
-    free(z_buffer);
+#else
+    raw_write(contents.data(), contents.size());
 #endif
     if (cur_block)
         finish_block(0);
     pkg->finish_chunk(name, first_block);
+#ifdef USE_ZLIB
+    pkg->digests[first_block] = digest;
+#endif
+    pkg->codecs[first_block] = codec;
 }
 
 void chunk_writer::raw_write(const void *data, plen_t len)
@@ -756,6 +940,7 @@ void chunk_writer::raw_write(const void *data, plen_t len)
         pkg->seek(cur_block + block_len + sizeof(block_header));
         if (::write(pkg->fd, data, space) != (ssize_t)space)
             sysfail("write error while saving");
+        pkg->bytes_written += space;
         data = (char*)data + space;
         block_len += space;
         len -= space;
@@ -771,6 +956,7 @@ void chunk_writer::finish_block(plen_t next)
     pkg->seek(cur_block);
     if (::write(pkg->fd, &head, sizeof(head)) != sizeof(head))
         sysfail("write error while saving");
+    pkg->bytes_written += sizeof(head);
 
     pkg->block_map[cur_block] = bm_p(block_len, next);
 }
@@ -780,24 +966,7 @@ void chunk_writer::write(const void *data, plen_t len)
     ASSERT(data);
     ASSERT(!pkg->aborted);
 
-#ifdef USE_ZLIB
-    zs.next_in  = (Bytef*)data;
-    zs.avail_in = len;
-    while (zs.avail_in)
-    {
-        if (!zs.avail_out)
-        {
-            raw_write(z_buffer, zs.next_out - z_buffer);
-            zs.next_out  = z_buffer;
-            zs.avail_out = ZB_SIZE;
-        }
-        // we don't allow Z_BUF_ERROR, so it's fatal for us
-        if (deflate(&zs, Z_NO_FLUSH) != Z_OK)
-            fail("save file compression failed: %s", zs.msg);
-    }
-#else
-    raw_write(data, len);
-#endif
+    contents.insert(contents.end(), (const char*)data, (const char*)data + len);
 }
 
 void chunk_reader::init(plen_t start)
@@ -820,7 +989,11 @@ void chunk_reader::init(plen_t start)
     if (inflateInit(&zs))
         fail("save file decompression failed during init: %s", zs.msg);
     eof = false;
+    mapped = pkg->update_map();
+    digest.crc = crc32(0, Z_NULL, 0);
+    digest.len = 0;
 #endif
+    pkg->read_stats.chunks++;
 }
 
 chunk_reader::chunk_reader(package *parent, plen_t start)
@@ -846,6 +1019,8 @@ chunk_reader::~chunk_reader()
     dprintf("chunk_reader: closing\n");
 
 #ifdef USE_ZLIB
+    pkg->read_stats.bytes_in += zs.total_in;
+    pkg->read_stats.bytes_out += zs.total_out;
     if (inflateEnd(&zs) != Z_OK)
         fail("save file decompression failed during clean-up: %s", zs.msg);
 #endif
@@ -869,6 +1044,7 @@ plen_t chunk_reader::raw_read(void *data, plen_t len)
             block_header bl;
             pkg->seek(next_block);
             ssize_t res = ::read(pkg->fd, &bl, sizeof(block_header));
+            pkg->read_stats.syscalls++;
             if (res < 0)
                 sysfail("error reading the save file");
             if (res != sizeof(block_header))
@@ -888,6 +1064,7 @@ plen_t chunk_reader::raw_read(void *data, plen_t len)
         if (s > block_left)
             s = block_left;
         ssize_t res = ::read(pkg->fd, buf, s);
+        pkg->read_stats.syscalls++;
         if (res < 0)
             sysfail("error reading the save file");
         if ((plen_t)res != s)
@@ -902,6 +1079,43 @@ plen_t chunk_reader::raw_read(void *data, plen_t len)
     return (char*)buf - (char*)data;
 }
 
+#ifdef USE_ZLIB
+/**
+ * Point zlib's input at the rest of the current block, or the whole next
+ * block, of the mapped file; no data is copied.
+ *
+ * @return the number of bytes available, or 0 at the end of the chunk.
+ */
+plen_t chunk_reader::map_next()
+{
+    if (!block_left)
+    {
+        if (!next_block)
+            return 0;
+
+        block_header bl;
+        if (next_block + sizeof(block_header) > pkg->map_len)
+            corrupted("save file corrupted -- block past eof");
+        memcpy(&bl, pkg->map_data + next_block, sizeof(block_header));
+
+        off = next_block + sizeof(block_header);
+        block_left = htole(bl.len);
+        next_block = htole(bl.next);
+        // This reeks of on-disk corruption (zeroed data).
+        if (!block_left)
+            corrupted("save file corrupted -- empty block");
+        if (off + block_left > pkg->map_len)
+            corrupted("save file corrupted -- block past eof");
+    }
+
+    const plen_t s = block_left;
+    zs.next_in = (Bytef*)pkg->map_data + off;
+    off += s;
+    block_left = 0;
+    return s;
+}
+#endif
+
 plen_t chunk_reader::read(void *data, plen_t len)
 {
     ASSERT(data);
@@ -914,14 +1128,24 @@ plen_t chunk_reader::read(void *data, plen_t len)
     if (eof)
         return 0;
 
+    const auto start = chrono::steady_clock::now();
+    // The file may have been remapped elsewhere since the last call.
+    if (mapped && zs.avail_in)
+        zs.next_in = (Bytef*)pkg->map_data + off - zs.avail_in;
+
     zs.next_out  = (Bytef*)data;
     zs.avail_out = len;
     while (zs.avail_out)
     {
         if (!zs.avail_in)
         {
-            zs.next_in  = z_buffer;
-            zs.avail_in = raw_read(z_buffer, sizeof(z_buffer));
+            if (mapped)
+                zs.avail_in = map_next();
+            else
+            {
+                zs.next_in  = z_buffer;
+                zs.avail_in = raw_read(z_buffer, sizeof(z_buffer));
+            }
             if (!zs.avail_in)
                 corrupted("save file corrupted -- block truncated");
         }
@@ -929,12 +1153,21 @@ plen_t chunk_reader::read(void *data, plen_t len)
         if (res == Z_STREAM_END)
         {
             eof = true;
-            return zs.next_out - (Bytef*)data;
+            break;
         }
         if (res != Z_OK)
             corrupted("save file decompression failed: %s", zs.msg);
     }
-    return zs.next_out - (Bytef*)data;
+
+    const plen_t done = zs.next_out - (Bytef*)data;
+    digest.crc = crc32(digest.crc, (Bytef*)data, done);
+    digest.len += done;
+    // Having read the whole chunk, we know its digest.
+    if (eof)
+        pkg->digests[first_block] = digest;
+    pkg->read_stats.usecs += chrono::duration_cast<chrono::microseconds>(
+                                 chrono::steady_clock::now() - start).count();
+    return done;
 #else
     return raw_read(data, len);
 #endif
@@ -13,12 +13,50 @@
 #define DO_FSYNC
 #endif
 
+#if defined(UNIX) && defined(USE_ZLIB)
+#define USE_MMAP
+#endif
+
 #define MAX_CHUNK_NAME_LENGTH 255
 
 typedef uint32_t plen_t;
 
 class package;
 
+// How a chunk is compressed. This is stored in the directory, so values must
+// not be changed or reused.
+enum chunk_codec
+{
+    CODEC_ZLIB,      // zlib at its default level; all chunks of older saves
+    CODEC_ZLIB_FAST, // zlib at its fastest, for chunks rewritten all the time
+    CODEC_ZLIB_BEST, // zlib at its strongest, for chunks rarely rewritten
+    NUM_CODECS
+};
+
+// Counters for comparing how long reading chunks takes with and without
+// mmap.
+struct package_read_stats
+{
+    uint64_t chunks;    // chunk readers opened
+    uint64_t bytes_in;  // compressed bytes consumed
+    uint64_t bytes_out; // uncompressed bytes produced
+    uint64_t syscalls;  // seeks and reads of the save file
+    uint64_t usecs;     // time spent inside chunk_reader::read()
+};
+
+// Identifies the uncompressed contents of a chunk, so that rewriting a chunk
+// with the same contents can be skipped.
+struct chunk_digest
+{
+    uint32_t crc;
+    plen_t len;
+
+    bool operator==(const chunk_digest &other) const
+    {
+        return crc == other.crc && len == other.len;
+    }
+};
+
 class chunk_writer
 {
 private:
@@ -27,14 +65,16 @@ private:
     plen_t first_block;
     plen_t cur_block;
     plen_t block_len;
-#ifdef USE_ZLIB
-    z_stream zs;
-    Bytef *z_buffer;
-#endif
+    chunk_codec codec;
+    // The whole chunk is collected before anything is written, so that an
+    // unchanged chunk never touches the disk.
+    vector<char> contents;
     void raw_write(const void *data, plen_t len);
     void finish_block(plen_t next);
+    void flush();
 public:
-    chunk_writer(package *parent, const string &_name);
+    chunk_writer(package *parent, const string &_name,
+                 chunk_codec _codec = CODEC_ZLIB);
     ~chunk_writer();
     void write(const void *data, plen_t len);
     friend class package;
@@ -50,8 +90,11 @@ private:
     plen_t off, block_left;
 #ifdef USE_ZLIB
     bool eof;
+    bool mapped;
     z_stream zs;
     Bytef z_buffer[32768];
+    chunk_digest digest;
+    plen_t map_next();
 #endif
     plen_t raw_read(void *data, plen_t len);
 public:
@@ -68,12 +111,14 @@ public:
     package(const char* file, bool writeable, bool empty = false);
     package();
     ~package();
-    chunk_writer* writer(const string &name);
+    chunk_writer* writer(const string &name, chunk_codec codec = CODEC_ZLIB);
     chunk_reader* reader(const string &name);
     void commit();
     void delete_chunk(const string &name);
     bool has_chunk(const string &name);
     vector<string> list_chunks();
+    chunk_codec get_chunk_codec(const string &name);
+    void recompress_chunk(const string &name, chunk_codec codec);
     void abort();
     void unlink();
 
@@ -82,6 +127,15 @@ public:
     plen_t get_size() const { return file_len; };
     plen_t get_chunk_fragmentation(const string &name);
     plen_t get_chunk_compressed_length(const string &name);
+    plen_t get_bytes_written() const { return bytes_written; };
+    plen_t get_last_commit_bytes() const { return last_commit_bytes; };
+    int get_chunks_skipped() const { return chunks_skipped; };
+    const package_read_stats &get_read_stats() const { return read_stats; };
+    bool is_mapped() const;
+
+    // Whether chunks are read through a memory mapping of the save where the
+    // platform allows; otherwise they are read block by block.
+    static bool use_mmap;
 private:
     string filename;
     bool rw;
@@ -90,8 +144,17 @@ private:
     int n_users;
     bool dirty;
     bool aborted;
+    plen_t bytes_written;
+    plen_t last_commit_bytes;
+    int chunks_skipped;
+    package_read_stats read_stats;
 #ifdef DO_FSYNC
     bool tmp;
+#endif
+#ifdef USE_MMAP
+    const char *map_data;
+    plen_t map_len;
+    bool map_failed;
 #endif
     map<string, plen_t> directory;
     map<plen_t, plen_t> free_blocks;
@@ -99,15 +162,21 @@ private:
     map<plen_t, pair<plen_t, plen_t> > block_map;
     set<plen_t> new_chunks;
     map<plen_t, uint32_t> reader_count;
+    map<plen_t, chunk_digest> digests;
+    map<plen_t, chunk_codec> codecs;
     plen_t extend_block(plen_t at, plen_t size, plen_t by);
     plen_t alloc_block(plen_t &size);
     void finish_chunk(const string &name, plen_t at);
     void free_chunk(const string &name);
+    bool chunk_unchanged(const string &name, chunk_codec codec,
+                         const chunk_digest &digest, const vector<char> &data);
     plen_t write_directory();
     void collect_blocks();
     void free_block_chain(plen_t at);
     void free_block(plen_t at, plen_t size);
     void seek(plen_t to);
+    bool update_map();
+    void unmap();
     void fsck();
     void read_directory(plen_t start, uint8_t version);
     void trace_chunk(plen_t start);
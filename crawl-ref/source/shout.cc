@@ -8,6 +8,10 @@
 #include "shout.h"
 
 #include <sstream>
+#ifdef DEBUG_NOISE_PROFILING
+# include <chrono>
+# include <cinttypes>
+#endif
 
 #include "act-iter.h"
 #include "areas.h"
@@ -36,7 +40,45 @@
 #include "view.h"
 #include "viewchar.h"
 
-static noise_grid _noise_grid;
+// The grid new noises are registered on. apply_noises() swaps it for a
+// spare before propagating, and grids go back on the spare list once done
+// with, so the large grids aren't copied or reallocated every turn.
+static unique_ptr<noise_grid> _noise_grid;
+static vector<unique_ptr<noise_grid>> _spare_noise_grids;
+
+#ifdef DEBUG_NOISE_PROFILING
+static struct
+{
+    uint64_t sweeps;
+    uint64_t noises;
+    uint64_t cells_visited;
+    uint64_t usecs;
+} _noise_profile;
+
+void noise_profile_out()
+{
+    const auto &pr = _noise_profile;
+    fprintf(stderr, "\nNoise propagation:\n");
+    fprintf(stderr, "%12" PRIu64 " sweeps, %" PRIu64 " noises, %" PRIu64
+                    " cells visited\n",
+            pr.sweeps, pr.noises, pr.cells_visited);
+    fprintf(stderr, "%12.3f s propagating (%.1f us/sweep)\n",
+            pr.usecs / 1e6, pr.sweeps ? (double) pr.usecs / pr.sweeps : 0.0);
+}
+# define NOISE_PROFILE(field, n) (_noise_profile.field += (n))
+#else
+# define NOISE_PROFILE(field, n) ((void) 0)
+#endif
+
+static unique_ptr<noise_grid> _new_noise_grid()
+{
+    if (_spare_noise_grids.empty())
+        return unique_ptr<noise_grid>(new noise_grid());
+
+    unique_ptr<noise_grid> grid = move(_spare_noise_grids.back());
+    _spare_noise_grids.pop_back();
+    return grid;
+}
 static void _actor_apply_noise(actor *act,
                                const coord_def &apparent_source,
                                int noise_intensity_millis,
@@ -771,16 +813,17 @@ void yell(const actor* mon)
 
 void apply_noises()
 {
-    // [ds] This copying isn't awesome, but we cannot otherwise handle
-    // the case where one set of noises wakes up monsters who then let
-    // out yips of their own, modifying _noise_grid while it is in the
-    // middle of propagate_noise().
-    if (_noise_grid.dirty())
+    // [ds] We cannot propagate on _noise_grid itself: one set of noises
+    // may wake up monsters who then let out yips of their own, modifying
+    // _noise_grid while it is in the middle of propagate_noise(). So move
+    // the noises out onto their own grid first.
+    if (_noise_grid && _noise_grid->dirty())
     {
-        noise_grid copy = _noise_grid;
-        // Reset the main grid.
-        _noise_grid.reset();
-        copy.propagate_noise();
+        unique_ptr<noise_grid> grid = move(_noise_grid);
+        _noise_grid = _new_noise_grid();
+        grid->propagate_noise();
+        grid->reset();
+        _spare_noise_grids.push_back(move(grid));
     }
 }
 
@@ -825,7 +868,9 @@ bool noisy(int original_loudness, const coord_def& where,
     // Add +1 to scaled_loudness so that all squares adjacent to a
     // sound of loudness 1 will hear the sound.
     const string noise_msg(msg? msg : "");
-    _noise_grid.register_noise(
+    if (!_noise_grid)
+        _noise_grid = _new_noise_grid();
+    _noise_grid->register_noise(
         noise_t(where, noise_msg, (scaled_loudness + 1) * multiplier, who));
 
     // Some users of noisy() want an immediate answer to whether the
@@ -981,11 +1026,27 @@ noise_grid::noise_grid()
 
 void noise_grid::reset()
 {
-    cells.init(noise_cell());
+    for (const coord_def &p : touched_cells)
+        cells(p) = noise_cell();
+    touched_cells.clear();
     noises.clear();
     affected_actor_count = 0;
 }
 
+void noise_grid::apply_noise_to_cell(const coord_def &pos,
+                                     int noise_intensity_millis,
+                                     int noise_id, int travel_distance,
+                                     const coord_def &neighbour_delta)
+{
+    noise_cell &cell(cells(pos));
+    // A cell noise has reached always has a noise id, so this is the
+    // first time this cell has been reached.
+    if (cell.noise_id < 0)
+        touched_cells.push_back(pos);
+    cell.apply_noise(noise_intensity_millis, noise_id, travel_distance,
+                     neighbour_delta);
+}
+
 void noise_grid::register_noise(const noise_t &noise)
 {
     noise_cell &target_cell(cells(noise.noise_source));
@@ -994,10 +1055,8 @@ void noise_grid::register_noise(const noise_t &noise)
         const int noise_index = noises.size();
         noises.push_back(noise);
         noises[noise_index].noise_id = noise_index;
-        cells(noise.noise_source).apply_noise(noise.noise_intensity_millis,
-                                              noise_index,
-                                              0,
-                                              coord_def(0, 0));
+        apply_noise_to_cell(noise.noise_source, noise.noise_intensity_millis,
+                            noise_index, 0, coord_def(0, 0));
     }
 }
 
@@ -1010,8 +1069,17 @@ void noise_grid::propagate_noise()
     dprf(DIAG_NOISE, "noise_grid: %u noises to apply",
          (unsigned int)noises.size());
 #endif
-    vector<coord_def> noise_perimeter[2];
+#ifdef DEBUG_NOISE_PROFILING
+    const auto start = chrono::steady_clock::now();
+    NOISE_PROFILE(sweeps, 1);
+    NOISE_PROFILE(noises, noises.size());
+#endif
+    // All the noises are propagated together, one step of travel distance
+    // at a time. A cell keeps only the loudest noise to reach it, and noise
+    // stops spreading once it is no longer audible.
     int circ_index = 0;
+    noise_perimeter[0].clear();
+    noise_perimeter[1].clear();
 
     for (const noise_t &noise : noises)
         noise_perimeter[circ_index].push_back(noise.noise_source);
@@ -1022,6 +1090,7 @@ void noise_grid::propagate_noise()
         const vector<coord_def> &perimeter(noise_perimeter[circ_index]);
         vector<coord_def> &next_perimeter(noise_perimeter[!circ_index]);
         ++travel_distance;
+        NOISE_PROFILE(cells_visited, perimeter.size());
         for (const coord_def p : perimeter)
         {
             const noise_cell &cell(cells(p));
@@ -1070,6 +1139,11 @@ void noise_grid::propagate_noise()
         circ_index = !circ_index;
     }
 
+#ifdef DEBUG_NOISE_PROFILING
+    NOISE_PROFILE(usecs, chrono::duration_cast<chrono::microseconds>(
+                             chrono::steady_clock::now() - start).count());
+#endif
+
 #ifdef DEBUG_NOISE_PROPAGATION
     if (affected_actor_count)
     {
@@ -1100,16 +1174,16 @@ bool noise_grid::propagate_noise_to_neighbour(int base_attenuation,
         : base_attenuation;
     const int attenuated_noise_intensity =
         cell.noise_intensity_millis - turn_attenuation;
-    if (noise_is_audible(attenuated_noise_intensity))
+    if (noise_is_audible(attenuated_noise_intensity)
+        && neighbour.can_apply_noise(attenuated_noise_intensity))
     {
         const int neighbour_old_distance = neighbour.noise_travel_distance;
-        if (neighbour.apply_noise(attenuated_noise_intensity,
-                                  cell.noise_id,
-                                  travel_distance,
-                                  next_pos - current_pos))
-            // Return true only if we hadn't already registered this
-            // cell as a neighbour (presumably with a lower volume).
-            return neighbour_old_distance != travel_distance;
+        apply_noise_to_cell(next_pos, attenuated_noise_intensity,
+                            cell.noise_id, travel_distance,
+                            next_pos - current_pos);
+        // Return true only if we hadn't already registered this
+        // cell as a neighbour (presumably with a lower volume).
+        return neighbour_old_distance != travel_distance;
     }
     return false;
 }
@@ -3208,8 +3208,8 @@ spret cast_fulminating_prism(actor* caster, int pow,
 
 monster* find_spectral_weapon(const actor* agent)
 {
-    if (agent->props.exists("spectral_weapon"))
-        return monster_by_mid(agent->props["spectral_weapon"].get_int());
+    if (agent->props.exists(SPECTRAL_WEAPON_KEY))
+        return monster_by_mid(agent->props[SPECTRAL_WEAPON_KEY].get_int());
     else
         return nullptr;
 }
@@ -3296,7 +3296,7 @@ spret cast_spectral_weapon(actor *agent, int pow, god_type god, bool fail)
     }
 
     mons->summoner = agent->mid;
-    agent->props["spectral_weapon"].get_int() = mons->mid;
+    agent->props[SPECTRAL_WEAPON_KEY].get_int() = mons->mid;
 
     return spret::success;
 }
@@ -3310,7 +3310,7 @@ void end_spectral_weapon(monster* mons, bool killed, bool quiet)
     actor *owner = actor_by_mid(mons->summoner);
 
     if (owner)
-        owner->props.erase("spectral_weapon");
+        owner->props.erase(SPECTRAL_WEAPON_KEY);
 
     if (!quiet)
     {
@@ -3334,7 +3334,7 @@ bool trigger_spectral_weapon(actor* agent, const actor* target)
     // Don't try to attack with a nonexistent spectral weapon
     if (!spectral_weapon || !spectral_weapon->alive())
     {
-        agent->props.erase("spectral_weapon");
+        agent->props.erase(SPECTRAL_WEAPON_KEY);
         return false;
     }
 
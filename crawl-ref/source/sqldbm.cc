@@ -7,11 +7,15 @@
 
 #include "sqldbm.h"
 
+#include <algorithm>
 #include <cstring>
 #include <fcntl.h>
+#include <iterator>
+#include <map>
 #include <unistd.h>
 
 #include "end.h"
+#include "stringutil.h"
 #include "syscalls.h"
 
 #ifdef USE_SQLITE_DBM
@@ -45,9 +49,12 @@ private:
     int nretries;
 };
 
-SQL_DBM::SQL_DBM(const string &dbname, bool _readonly, bool do_open)
+SQL_DBM::SQL_DBM(const string &dbname, bool _readonly, bool do_open,
+                 bool _immutable)
     : error(), errc(SQLITE_OK), db(nullptr), s_insert(nullptr), s_remove(nullptr),
-      s_query(nullptr), s_iterator(nullptr), dbfile(dbname), readonly(_readonly)
+      s_query(nullptr), s_iterator(nullptr), s_index(nullptr),
+      s_rowkey(nullptr), dbfile(dbname), readonly(_readonly),
+      immutable(_immutable)
 {
     if (do_open && !dbfile.empty())
         open();
@@ -102,15 +109,33 @@ From SQLite's documentation:
 
 ... which saves us a lot of trouble.
 */
+#ifndef ANCIENT_SQLITE
+    string filename = dbfile;
+    int flags = readonly ? SQLITE_OPEN_READONLY :
+                (SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE);
+    if (immutable)
+    {
+        // Nothing may write to an immutable db while it's open, so sqlite
+        // can skip locking and checking for changes.
+        filename = "file:";
+        for (char c : dbfile)
+        {
+            if (c == '%' || c == '?' || c == '#')
+                filename += make_stringf("%%%02X", c);
+            else
+                filename += c;
+        }
+        filename += "?immutable=1";
+        flags = SQLITE_OPEN_READONLY | SQLITE_OPEN_URI;
+    }
+#endif
+
 #ifdef ANCIENT_SQLITE
     if (ec(sqlite3_open(
                 dbfile.c_str(), &db
 #else
     if (ec(sqlite3_open_v2(
-                dbfile.c_str(), &db,
-                readonly ? SQLITE_OPEN_READONLY :
-                (SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE),
-                nullptr
+                filename.c_str(), &db, flags, nullptr
 #endif
               )) != SQLITE_OK)
     {
@@ -122,6 +147,14 @@ From SQLite's documentation:
         return errc;
     }
 
+    if (immutable)
+    {
+        // Read through a shared mapping of the whole file, so processes
+        // using the same db share its pages.
+        return ec(sqlite3_exec(db, "PRAGMA mmap_size = 268435456;",
+                               nullptr, nullptr, nullptr));
+    }
+
     init_schema();
     return errc;
 }
@@ -157,6 +190,8 @@ void SQL_DBM::close()
         finalise_query(&s_remove);
         finalise_query(&s_query);
         finalise_query(&s_iterator);
+        finalise_query(&s_index);
+        finalise_query(&s_rowkey);
         sqlite3_close(db);
         db = nullptr;
     }
@@ -297,6 +332,166 @@ int SQL_DBM::init_iterator()
         prepare_query(&s_iterator, "SELECT key FROM dbm");
 }
 
+int SQL_DBM::build_index(term_extractor terms_of)
+{
+    // Only indexed dbs have the table, so that a lookup in any other db
+    // fails and its caller falls back to scanning every entry.
+    // Postings are the delta-encoded rowids of the entries having the term.
+    // Terms and rowids go through sqlite as plain ints: the int64 calls
+    // would see the int that sqldbm.h makes of SQLITE_INT64_TYPE.
+    if (ec(sqlite3_exec(db, "CREATE TABLE dbm_index (term INTEGER PRIMARY KEY,"
+                            "                        entries BLOB);",
+                        nullptr, nullptr, nullptr)) != SQLITE_OK)
+    {
+        return errc;
+    }
+
+    sqlite3_stmt *entries = nullptr;
+    if (prepare_query(&entries, "SELECT rowid, key, value FROM dbm "
+                                "ORDER BY rowid") != SQLITE_OK)
+    {
+        return errc;
+    }
+
+    map<uint32_t, vector<int>> postings;
+    vector<uint32_t> terms;
+    int err;
+    while ((err = ec(sqlite3_step(entries))) == SQLITE_ROW)
+    {
+        const int rowid = sqlite3_column_int(entries, 0);
+        terms.clear();
+        terms_of((const char *) sqlite3_column_text(entries, 1),
+                 (const char *) sqlite3_column_text(entries, 2), terms);
+        sort(terms.begin(), terms.end());
+        terms.erase(unique(terms.begin(), terms.end()), terms.end());
+        for (uint32_t term : terms)
+            postings[term].push_back(rowid);
+    }
+    finalise_query(&entries);
+    if (err != SQLITE_DONE)
+        return ec(err);
+
+    sqlite3_stmt *insert = nullptr;
+    if (prepare_query(&insert, "INSERT INTO dbm_index VALUES (?, ?)")
+        != SQLITE_OK)
+    {
+        return errc;
+    }
+
+    string blob;
+    for (const auto &posting : postings)
+    {
+        blob.clear();
+        int last = 0;
+        for (int rowid : posting.second)
+        {
+            // LEB128, since the gaps are mostly small.
+            unsigned int delta = rowid - last;
+            last = rowid;
+            for (; delta >= 0x80; delta >>= 7)
+                blob += (char) ((delta & 0x7f) | 0x80);
+            blob += (char) delta;
+        }
+
+        sqlite3_bind_int(insert, 1, posting.first);
+        sqlite3_bind_blob(insert, 2, blob.data(), blob.size(),
+                          SQLITE_TRANSIENT);
+        err = ec(sqlite3_step(insert));
+        sqlite3_reset(insert);
+        if (err != SQLITE_DONE)
+            break;
+    }
+    finalise_query(&insert);
+    return ec(err == SQLITE_DONE ? SQLITE_OK : err);
+}
+
+int SQL_DBM::index_postings(uint32_t term, vector<int> *entries)
+{
+    if (!s_index
+        && prepare_query(&s_index, "SELECT entries FROM dbm_index "
+                                   "WHERE term = ?") != SQLITE_OK)
+    {
+        return errc;
+    }
+
+    sqlite3_bind_int(s_index, 1, term);
+    int err = ec(sqlite3_step(s_index));
+    if (err == SQLITE_ROW)
+    {
+        const unsigned char *blob =
+            (const unsigned char *) sqlite3_column_blob(s_index, 0);
+        const int len = sqlite3_column_bytes(s_index, 0);
+        int rowid = 0;
+        unsigned int delta = 0;
+        int shift = 0;
+        for (int i = 0; i < len; ++i)
+        {
+            delta |= (unsigned int) (blob[i] & 0x7f) << shift;
+            shift += 7;
+            if (!(blob[i] & 0x80))
+            {
+                rowid += delta;
+                entries->push_back(rowid);
+                delta = 0;
+                shift = 0;
+            }
+        }
+        err = SQLITE_OK;
+    }
+    else if (err == SQLITE_DONE)
+        err = SQLITE_OK;
+    sqlite3_reset(s_index);
+
+    return ec(err);
+}
+
+unique_ptr<vector<string>> SQL_DBM::index_lookup(const vector<uint32_t> &terms)
+{
+    unique_ptr<vector<string>> keys;
+    if (!db || terms.empty())
+        return keys;
+
+    vector<int> candidates, entries, both;
+    for (size_t i = 0; i < terms.size(); ++i)
+    {
+        entries.clear();
+        // Databases that were never indexed lack the table.
+        if (index_postings(terms[i], &entries) != SQLITE_OK)
+            return keys;
+
+        if (i == 0)
+            candidates.swap(entries);
+        else
+        {
+            both.clear();
+            set_intersection(candidates.begin(), candidates.end(),
+                             entries.begin(), entries.end(),
+                             back_inserter(both));
+            candidates.swap(both);
+        }
+        if (candidates.empty())
+            break;
+    }
+
+    if (!s_rowkey
+        && prepare_query(&s_rowkey, "SELECT key FROM dbm WHERE rowid = ?")
+           != SQLITE_OK)
+    {
+        return keys;
+    }
+
+    keys.reset(new vector<string>);
+    for (int rowid : candidates)
+    {
+        sqlite3_bind_int(s_rowkey, 1, rowid);
+        if (ec(sqlite3_step(s_rowkey)) == SQLITE_ROW)
+            keys->emplace_back((const char *) sqlite3_column_text(s_rowkey, 0));
+        sqlite3_reset(s_rowkey);
+    }
+    sort(keys->begin(), keys->end());
+    return keys;
+}
+
 int SQL_DBM::finalise_query(sqlite3_stmt **q)
 {
     if (!*q)
@@ -408,6 +603,20 @@ SQL_DBM *dbm_open(const char *filename, int mode, int)
     return n;
 }
 
+// Open a prebuilt db read-only and memory-mapped; it must not change while
+// it is open.
+SQL_DBM *dbm_open_shared(const char *filename)
+{
+    SQL_DBM *n = new SQL_DBM(filename, true, true, true);
+    if (!n->is_open())
+    {
+        delete n;
+        return nullptr;
+    }
+
+    return n;
+}
+
 int dbm_close(SQL_DBM *db)
 {
     delete db;
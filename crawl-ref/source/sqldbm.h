@@ -8,7 +8,9 @@
 #ifdef USE_SQLITE_DBM
 
 #include <sys/types.h>
+#include <functional>
 #include <memory>
+#include <vector>
 
 #define SQLITE_INT64_TYPE int
 #define SQLITE_UINT64_TYPE unsigned int
@@ -47,7 +49,8 @@ private:
 class SQL_DBM
 {
 public:
-    SQL_DBM(const string &db = "", bool readonly = true, bool open = false);
+    SQL_DBM(const string &db = "", bool readonly = true, bool open = false,
+            bool immutable = false);
     ~SQL_DBM();
 
     bool is_open() const;
@@ -62,6 +65,15 @@ public:
     int insert(const string &key, const string &value);
     int remove(const string &key);
 
+    // An optional inverted index from integer terms (e.g. trigrams) to
+    // entries, built once all entries have been inserted.
+    typedef function<void (const string &key, const string &value,
+                           vector<uint32_t> &terms)> term_extractor;
+    int build_index(term_extractor terms_of);
+    // The sorted keys of the entries having all of the terms,
+    // or nullptr if there are no terms or the db has no index.
+    unique_ptr<vector<string>> index_lookup(const vector<uint32_t> &terms);
+
 public:
     string error;
     int errc;
@@ -79,6 +91,7 @@ private:
     int try_insert(const string &key, const string &value);
     int do_insert(const string &key, const string &value);
     int do_query(const string &key, string *result);
+    int index_postings(uint32_t term, vector<int> *entries);
 
 private:
     sqlite3      *db;
@@ -86,11 +99,15 @@ private:
     sqlite3_stmt *s_remove;
     sqlite3_stmt *s_query;
     sqlite3_stmt *s_iterator;
+    sqlite3_stmt *s_index;
+    sqlite3_stmt *s_rowkey;
     string       dbfile;
     bool readonly;
+    bool immutable;
 };
 
 SQL_DBM  *dbm_open(const char *filename, int open_mode, int permissions);
+SQL_DBM  *dbm_open_shared(const char *filename);
 int   dbm_close(SQL_DBM *db);
 
 sql_datum dbm_fetch(SQL_DBM *db, const sql_datum &key);
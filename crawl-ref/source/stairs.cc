@@ -985,6 +985,9 @@ void floor_transition(dungeon_feature_type how,
         else
             mpr("A rune on the stairs sparks and fizzles.");
     }
+
+    // The game has paused for the level change anyway.
+    pregen_background_step();
 }
 
 /**
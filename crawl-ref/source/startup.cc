@@ -62,6 +62,7 @@
  #include "windowmanager.h"
 #endif
 #include "ui.h"
+#include "wiz-fsim.h"
 
 using namespace ui;
 
@@ -169,6 +170,29 @@ static void _initialize()
     }
 #endif
 
+    if (!crawl_state.save_bench_dir.empty())
+    {
+        release_cli_signals();
+        run_save_benchmark();
+        // doesn't return
+    }
+
+    if (!crawl_state.arena_tournament_file.empty())
+    {
+        release_cli_signals();
+        run_arena_tournament(crawl_state.arena_tournament_file);
+        // doesn't return
+    }
+
+#ifdef WIZARD
+    if (!crawl_state.fsim_combo.empty())
+    {
+        release_cli_signals();
+        fight_sim_batch(crawl_state.fsim_combo, crawl_state.fsim_double_scale);
+        // doesn't return
+    }
+#endif
+
     if (!crawl_state.test_list)
     {
         if (!crawl_state.io_inited)
@@ -250,66 +274,25 @@ static void _zap_los_monsters(bool items_also)
     }
 }
 
-static void _pregen_levels(const branch_type branch, progress_popup &progress)
-{
-    for (int i = 1; i <= branches[branch].numlevels; i++)
-    {
-        level_id new_level = level_id(branch, i);
-        dprf("Pregenerating %s:%d", branches[new_level.branch].abbrevname,
-                                    new_level.depth);
-        progress.advance_progress();
-        generate_level(new_level);
-    }
-}
-
 static void _pregen_dungeon()
 {
     // be sure that AK start doesn't interfere with the builder
     unwind_var<game_chapter> chapter(you.chapter, CHAPTER_ORB_HUNTING);
 
-    // bel's original proposal generated D to lair depth, then lair, then D
-    // to orc depth, then orc, then the rest of D. I have simplified this to
-    // just generate whole branches at a time -- I am not sure how much real
-    // impact this has. One idea might be to shuffle this slightly based on
-    // the seed.
-    // TODO: probably need to do portal vaults too?
-    // Should this use something like logical_branch_order?
-    const vector<branch_type> generation_order =
-    {
-        BRANCH_DUNGEON,
-        BRANCH_TEMPLE,
-        BRANCH_LAIR,
-        BRANCH_ORC,
-        BRANCH_SPIDER,
-        BRANCH_SNAKE,
-        BRANCH_SHOALS,
-        BRANCH_SWAMP,
-        BRANCH_VAULTS,
-        BRANCH_CRYPT,
-        BRANCH_DEPTHS,
-        BRANCH_VESTIBULE,
-        BRANCH_ELF,
-        BRANCH_ZOT,
-        BRANCH_SLIME,
-        BRANCH_TOMB,
-        BRANCH_TARTARUS,
-        BRANCH_COCYTUS,
-        BRANCH_DIS,
-        BRANCH_GEHENNA,
-    };
-
     progress_popup progress("Generating dungeon...\n\n", 35);
     progress.advance_progress();
-    // TODO: why is dungeon invalid? it's not set up properly in
-    // `initialise_branch_depths` for some reason. The vestibule is invalid
-    // because its depth isn't set until the player actually enters a portal.
-    for (auto br : generation_order)
-        if (brentry[br].is_valid()
-            || br == BRANCH_DUNGEON || br == BRANCH_VESTIBULE)
+    branch_type last_branch = NUM_BRANCHES;
+    for (const level_id &new_level : pregen_level_order())
+    {
+        if (new_level.branch != last_branch)
         {
+            if (last_branch != NUM_BRANCHES)
+                progress.advance_progress();
+            last_branch = new_level.branch;
+
             string status = "\nbuilding ";
 
-            switch (br)
+            switch (last_branch)
             {
             case BRANCH_SPIDER:
             case BRANCH_SNAKE:
@@ -320,13 +303,18 @@ static void _pregen_dungeon()
                 status += "another lair branch";
                 break;
             default:
-                status += branches[br].longname;
+                status += branches[last_branch].longname;
                 break;
             }
             progress.set_status_text(status);
-            _pregen_levels(br, progress);
-            progress.advance_progress();
         }
+
+        dprf("Pregenerating %s:%d", branches[new_level.branch].abbrevname,
+                                    new_level.depth);
+        progress.advance_progress();
+        generate_level(new_level);
+    }
+    progress.advance_progress();
 }
 
 static void _post_init(bool newc)
@@ -355,7 +343,12 @@ static void _post_init(bool newc)
     if (newc)
     {
         if (Options.pregen_dungeon && crawl_state.game_standard_levelgen())
-            _pregen_dungeon();
+        {
+            if (Options.pregen_background)
+                pregen_background_start();
+            else
+                _pregen_dungeon();
+        }
 
         you.entering_level = false;
         you.transit_stair = DNGN_UNSEEN;
@@ -1313,6 +1306,7 @@ bool startup_step()
     if (choice.filename.empty() && !choice.name.empty())
         choice.filename = get_save_filename(choice.name);
 
+    start_save_session();
     if (save_exists(choice.filename) && restore_game(choice.filename))
         save_player_name();
     else if (choose_game(ng, choice, defaults)
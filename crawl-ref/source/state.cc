@@ -37,7 +37,9 @@ game_state::game_state()
       last_type(GAME_TYPE_UNSPECIFIED), last_game_exit(game_exit::unknown),
       marked_as_won(false), arena_suspended(false),
       generating_level(false), dump_maps(false), test(false), script(false),
-      build_db(false), tests_selected(),
+      build_db(false), tests_selected(), save_bench_dir(),
+      save_bench_iters(10), arena_tournament_file(), fsim_combo(),
+      fsim_double_scale(false),
 #ifdef DGAMELAUNCH
       throttle(true),
       bypassed_startup_menu(true),
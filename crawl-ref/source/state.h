@@ -80,6 +80,11 @@ struct game_state
     bool build_db;          // Set if we want to rebuild the db and exit.
     vector<string> tests_selected; // Tests to be run.
     vector<string> script_args;    // Arguments to scripts.
+    string save_bench_dir;  // Benchmark the saves in here and exit.
+    int save_bench_iters;   // Load/save passes over each save.
+    string arena_tournament_file; // Arena specs to run headless, then exit.
+    string fsim_combo;      // Run the fight simulator as this, then exit.
+    bool fsim_double_scale;
 
     bool throttle;
     bool bypassed_startup_menu;
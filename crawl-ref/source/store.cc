@@ -1252,9 +1252,146 @@ void CrawlHashTable::read(reader &th)
     ASSERT_VALIDITY();
 }
 
+/////////////////////////////
+// Keys and the table itself
+
+uint32_t store_key::hash_of(const char *key, size_t len)
+{
+    uint32_t h = _hash_basis;
+    for (size_t i = 0; i < len; ++i)
+        h = (h ^ static_cast<uint8_t>(key[i])) * _hash_prime;
+    return h;
+}
+
+CrawlHashTable::CrawlHashTable(const CrawlHashTable &other)
+    : slots(other.slots)
+{
+    nodes.reserve(other.nodes.size());
+    for (const auto &n : other.nodes)
+        nodes.emplace_back(new node(*n));
+}
+
+CrawlHashTable &CrawlHashTable::operator = (const CrawlHashTable &other)
+{
+    if (this != &other)
+    {
+        CrawlHashTable copy(other);
+        *this = move(copy);
+    }
+    return *this;
+}
+
+void CrawlHashTable::clear()
+{
+    nodes.clear();
+    slots.clear();
+}
+
+// The slot holding the key, or -1 if it isn't in the table.
+int CrawlHashTable::find_slot(const store_key &key) const
+{
+    if (slots.empty())
+        return -1;
+
+    const int mask = slots.size() - 1;
+    for (int i = key.hash & mask; slots[i]; i = (i + 1) & mask)
+    {
+        const node &n = *nodes[slots[i] - 1];
+        if (n.hash == key.hash && n.entry.first.size() == key.len
+            && !n.entry.first.compare(0, key.len, key.name, key.len))
+        {
+            return i;
+        }
+    }
+    return -1;
+}
+
+// Add nodes[index] to the table, which must have room for it.
+void CrawlHashTable::insert_slot(size_t index)
+{
+    const int mask = slots.size() - 1;
+    int i = nodes[index]->hash & mask;
+    while (slots[i])
+        i = (i + 1) & mask;
+    slots[i] = index + 1;
+}
+
+// Empty a slot, moving later entries of its probe sequence back so that
+// lookups don't need to step over tombstones.
+void CrawlHashTable::erase_slot(int slot)
+{
+    const int mask = slots.size() - 1;
+    int hole = slot;
+    for (int i = (slot + 1) & mask; slots[i]; i = (i + 1) & mask)
+    {
+        const int home = nodes[slots[i] - 1]->hash & mask;
+        // Can the entry at i be moved back to the hole without going
+        // before its home slot?
+        if (((i - home) & mask) >= ((i - hole) & mask))
+        {
+            slots[hole] = slots[i];
+            hole = i;
+        }
+    }
+    slots[hole] = 0;
+}
+
+void CrawlHashTable::rehash(size_t capacity)
+{
+    slots.assign(capacity, 0);
+    for (size_t i = 0; i < nodes.size(); ++i)
+        insert_slot(i);
+}
+
+CrawlHashTable::iterator CrawlHashTable::find(const store_key &key)
+{
+    const int slot = find_slot(key);
+    return slot < 0 ? end() : iterator(nodes.begin() + slots[slot] - 1);
+}
+
+CrawlHashTable::const_iterator CrawlHashTable::find(const store_key &key) const
+{
+    const int slot = find_slot(key);
+    return slot < 0 ? end() : const_iterator(nodes.begin() + slots[slot] - 1);
+}
+
+size_t CrawlHashTable::count(const store_key &key) const
+{
+    return find_slot(key) < 0 ? 0 : 1;
+}
+
+size_t CrawlHashTable::erase(const store_key &key)
+{
+    const int slot = find_slot(key);
+    if (slot < 0)
+        return 0;
+    erase(iterator(nodes.begin() + slots[slot] - 1));
+    return 1;
+}
+
+// Erase the entry, moving the last entry into its place. Returns an
+// iterator to the entry that is now there, so that loops erasing as they go
+// still see every entry.
+CrawlHashTable::iterator CrawlHashTable::erase(iterator pos)
+{
+    const size_t index = pos.it - nodes.begin();
+    const size_t last = nodes.size() - 1;
+
+    erase_slot(find_slot(store_key(pos->first)));
+    if (index != last)
+    {
+        const int moved = find_slot(store_key(nodes[last]->entry.first));
+        slots[moved] = index + 1;
+        nodes[index] = move(nodes[last]);
+    }
+    nodes.pop_back();
+
+    return iterator(nodes.begin() + index);
+}
+
 #ifdef DEBUG_PROPS
 static map<string, int> accesses;
-# define ACCESS(x) ++accesses[x]
+# define ACCESS(x) ++accesses[string(x)]
 #else
 # define ACCESS(x)
 #endif
@@ -1262,11 +1399,11 @@ static map<string, int> accesses;
 //////////////////
 // Misc functions
 
-bool CrawlHashTable::exists(const string &key) const
+bool CrawlHashTable::exists(const store_key &key) const
 {
     ACCESS(key);
     ASSERT_VALIDITY();
-    return find(key) != end();
+    return find_slot(key) >= 0;
 }
 
 void CrawlHashTable::assert_validity() const
@@ -1333,22 +1470,31 @@ void CrawlHashTable::assert_validity() const
 ////////////////////////////////
 // Accessors to contained values
 
-CrawlStoreValue& CrawlHashTable::get_value(const string &key)
+CrawlStoreValue& CrawlHashTable::get_value(const store_key &key)
 {
     ASSERT_VALIDITY();
     ACCESS(key);
+    const int slot = find_slot(key);
+    if (slot >= 0)
+        return nodes[slots[slot] - 1]->entry.second;
+
     // Inserts CrawlStoreValue() if the key was not found.
-    return map::operator[](key);
+    if ((nodes.size() + 1) * 2 > slots.size())
+        rehash(max<size_t>(8, slots.size() * 2));
+    nodes.emplace_back(new node(key));
+    insert_slot(nodes.size() - 1);
+    return nodes.back()->entry.second;
 }
 
-const CrawlStoreValue& CrawlHashTable::get_value(const string &key) const
+const CrawlStoreValue& CrawlHashTable::get_value(const store_key &key) const
 {
     ASSERT_VALIDITY();
     ACCESS(key);
-    auto iter = find(key);
-    ASSERTM(iter != end(), "trying to read non-existent property \"%s\"", key.c_str());
+    const int slot = find_slot(key);
+    ASSERTM(slot >= 0, "trying to read non-existent property \"%s\"",
+            string(key).c_str());
 
-    const CrawlStoreValue& store = iter->second;
+    const CrawlStoreValue& store = nodes[slots[slot] - 1]->entry.second;
     ASSERT(store.type != SV_NONE);
     ASSERT(!(store.flags & SFLAG_UNSET));
 
@@ -1777,3 +1923,49 @@ void dump_prop_accesses()
     fclose(f);
 }
 #endif
+
+#ifdef DEBUG_TESTS
+// Erase every other key while iterating, and check that the erase-as-you-go
+// loop still visits each entry exactly once, and that the table is left
+// consistent.
+void store_tests()
+{
+    const int num = 200;
+    CrawlHashTable table;
+    for (int i = 0; i < num; ++i)
+        table[make_stringf("key%d", i)] = i;
+
+    vector<int> visits(num, 0);
+    for (auto it = table.begin(); it != table.end();)
+    {
+        const int i = it->second.get_int();
+        if (i < 0 || i >= num)
+            die("store: bad value %d for %s", i, it->first.c_str());
+        ++visits[i];
+        if (i % 2)
+            it = table.erase(it);
+        else
+            ++it;
+    }
+
+    for (int i = 0; i < num; ++i)
+    {
+        if (visits[i] != 1)
+            die("store: key%d visited %d times", i, visits[i]);
+        const string key = make_stringf("key%d", i);
+        if (table.exists(key) != !(i % 2))
+            die("store: key%d %s after erase", i, i % 2 ? "kept" : "lost");
+        if (!(i % 2) && table[key].get_int() != i)
+            die("store: key%d has value %d", i, table[key].get_int());
+    }
+    if ((int)table.size() != num / 2)
+        die("store: %d entries left, expected %d", (int)table.size(), num / 2);
+
+    // Erasing the remainder from the front must empty the table.
+    for (auto it = table.begin(); it != table.end();)
+        it = table.erase(it);
+    if (!table.empty())
+        die("store: %d entries left after erasing all", (int)table.size());
+    table.assert_validity();
+}
+#endif
@@ -8,11 +8,13 @@
 
 #include <climits>
 #include <map>
+#include <memory>
 #include <string>
 #include <vector>
 
 class  reader;
 class  writer;
+class  store_key;
 class  CrawlHashTable;
 class  CrawlVector;
 struct item_def;
@@ -167,10 +169,12 @@ public:
     // type (strings for hashes, longs for vectors).
     CrawlStoreValue &operator [] (const string &key);
     CrawlStoreValue &operator [] (const char *key);
+    CrawlStoreValue &operator [] (const store_key &key);
     CrawlStoreValue &operator [] (const vec_size &index);
 
     const CrawlStoreValue &operator [] (const string &key) const;
     const CrawlStoreValue &operator [] (const char *key) const;
+    const CrawlStoreValue &operator [] (const store_key &key) const;
     const CrawlStoreValue &operator [] (const vec_size &index) const;
 
     // Typecast operators
@@ -243,27 +247,123 @@ protected:
     friend class CrawlVector;
 };
 
-class CrawlHashTable : public map<string, CrawlStoreValue>
+// A key for looking something up in a CrawlHashTable, hashed once when it
+// is made. Keys that are used often can be declared constexpr, so that
+// their hash is worked out at compile time rather than on every lookup:
+//     static constexpr store_key FOO_KEY("foo");
+// A key made from a string refers to that string's contents, so mustn't
+// outlive it.
+class store_key
+{
+public:
+    constexpr store_key(const char *key)
+        : name(key), len(_length(key)), hash(_hash(key, _hash_basis))
+    {
+    }
+    store_key(const string &key)
+        : name(key.c_str()), len(key.size()), hash(hash_of(name, len))
+    {
+    }
+
+    operator string() const { return string(name, len); }
+
+    static uint32_t hash_of(const char *key, size_t len);
+
+    const char *name;
+    size_t      len;
+    uint32_t    hash;
+
+private:
+    // 32-bit FNV-1a, written recursively so it can be constexpr.
+    static constexpr uint32_t _hash_basis = 2166136261u;
+    static constexpr uint32_t _hash_prime = 16777619u;
+
+    static constexpr size_t _length(const char *s)
+    {
+        return *s ? 1 + _length(s + 1) : 0;
+    }
+    static constexpr uint32_t _hash(const char *s, uint32_t h)
+    {
+        return *s ? _hash(s + 1, (h ^ static_cast<uint8_t>(*s)) * _hash_prime)
+                  : h;
+    }
+};
+
+// A hash table of CrawlStoreValues keyed by strings, in a flat open-
+// addressed table. Entries are kept in individual allocations, so references
+// to values stay good while other keys are added or removed, as with the
+// std::map this used to be. Iteration order is the order of insertion,
+// except that erasing an entry moves the last one into its place.
+class CrawlHashTable
 {
 public:
     friend class CrawlStoreValue;
 
+    typedef pair<const string, CrawlStoreValue> value_type;
+
+private:
+    struct node
+    {
+        node(const store_key &key) : entry(string(key), CrawlStoreValue()),
+                                     hash(key.hash) { }
+        node(const node &other) = default;
+
+        value_type entry;
+        uint32_t   hash;
+    };
+    typedef vector<unique_ptr<node>> node_list;
+
+public:
+    template <typename V, typename It>
+    class iter_base
+    {
+    public:
+        typedef forward_iterator_tag iterator_category;
+        typedef V                    value_type;
+        typedef ptrdiff_t            difference_type;
+        typedef V*                   pointer;
+        typedef V&                   reference;
+
+        iter_base() : it() { }
+        iter_base(It i) : it(i) { }
+        // Allow iterator -> const_iterator.
+        template <typename V2, typename It2>
+        iter_base(const iter_base<V2, It2> &other) : it(other.it) { }
+
+        V &operator*() const { return (*it)->entry; }
+        V *operator->() const { return &(*it)->entry; }
+        iter_base &operator++() { ++it; return *this; }
+        iter_base operator++(int) { iter_base c = *this; ++it; return c; }
+        bool operator==(const iter_base &other) const { return it == other.it; }
+        bool operator!=(const iter_base &other) const { return it != other.it; }
+
+    private:
+        It it;
+
+        friend class CrawlHashTable;
+        template <typename V2, typename It2> friend class iter_base;
+    };
+    typedef iter_base<value_type, node_list::iterator>             iterator;
+    typedef iter_base<const value_type, node_list::const_iterator> const_iterator;
+
+    CrawlHashTable() { }
+    CrawlHashTable(const CrawlHashTable &other);
+    CrawlHashTable(CrawlHashTable &&other) = default;
+    CrawlHashTable &operator = (const CrawlHashTable &other);
+    CrawlHashTable &operator = (CrawlHashTable &&other) = default;
+
     void write(writer &) const;
     void read(reader &);
 
-    bool exists(const string &key) const;
+    bool exists(const store_key &key) const;
 
     void assert_validity() const;
 
     // NOTE: If the const versions of get_value() or [] are given a
     // key which doesn't exist, they will assert.
-    const CrawlStoreValue& get_value(const string &key) const;
-    const CrawlStoreValue& get_value(const char *key) const
-    { return get_value(string(key)); }
-    const CrawlStoreValue& operator[] (const string &key) const
+    const CrawlStoreValue& get_value(const store_key &key) const;
+    const CrawlStoreValue& operator[] (const store_key &key) const
     { return get_value(key); }
-    const CrawlStoreValue& operator[] (const char *key) const
-    { return get_value(string(key)); }
 
     // NOTE: If get_value() or [] is given a key which doesn't exist
     // in the table, an unset/empty CrawlStoreValue will be created
@@ -272,12 +372,44 @@ public:
     // hash table has a type (rather than being heterogeneous)
     // then trying to assign a different type to the CrawlStoreValue
     // will assert.
-    CrawlStoreValue& get_value(const string &key);
-    CrawlStoreValue& get_value(const char *key)
-    { return get_value(string(key)); }
-    using map::operator[];
-    CrawlStoreValue& operator[] (const char *key)
-    { return get_value(string(key)); }
+    CrawlStoreValue& get_value(const store_key &key);
+    CrawlStoreValue& operator[] (const store_key &key)
+    { return get_value(key); }
+
+    // std::map style interface
+    size_t size() const  { return nodes.size(); }
+    bool   empty() const { return nodes.empty(); }
+    void   clear();
+
+    iterator       find(const store_key &key);
+    const_iterator find(const store_key &key) const;
+    size_t         count(const store_key &key) const;
+    size_t         erase(const store_key &key);
+    // Erasing moves the last entry into the erased one's place and returns
+    // an iterator to it, so loops that erase as they go must use
+    // "it = erase(it)" and only increment otherwise; "erase(it++)" skips
+    // the moved entry. Iterators to the erased and the last entries are
+    // invalidated. Adding a key (including via non-const get_value() or []
+    // on a missing one) may invalidate all iterators, but references to
+    // values always stay good until their own key is erased.
+    iterator       erase(iterator pos);
+
+    iterator       begin()       { return iterator(nodes.begin()); }
+    iterator       end()         { return iterator(nodes.end()); }
+    const_iterator begin() const { return const_iterator(nodes.begin()); }
+    const_iterator end() const   { return const_iterator(nodes.end()); }
+
+private:
+    // Entries, and the open-addressed table of (index into nodes + 1), or
+    // 0 for an empty slot. The table's size is zero or a power of two, and
+    // it's kept at most half full.
+    node_list   nodes;
+    vector<int> slots;
+
+    int  find_slot(const store_key &key) const;
+    void insert_slot(size_t index);
+    void erase_slot(int slot);
+    void rehash(size_t capacity);
 };
 
 // A CrawlVector is the vector version of CrawlHashTable, except that
@@ -356,6 +488,10 @@ public:
 void dump_prop_accesses();
 #endif
 
+#ifdef DEBUG_TESTS
+void store_tests();
+#endif
+
 // inlines... it sucks so badly to have to pander to ancient compilers with
 // no -flto
 inline CrawlStoreValue &CrawlStoreValue::operator [] (const string &key)
@@ -368,6 +504,11 @@ inline CrawlStoreValue &CrawlStoreValue::operator [] (const char* key)
     return get_table().get_value(key);
 }
 
+inline CrawlStoreValue &CrawlStoreValue::operator [] (const store_key &key)
+{
+    return get_table().get_value(key);
+}
+
 inline CrawlStoreValue &CrawlStoreValue::operator [] (const vec_size &index)
 {
     return get_vector()[index];
@@ -383,6 +524,11 @@ inline const CrawlStoreValue &CrawlStoreValue::operator [] (const char* key) con
     return get_table().get_value(key);
 }
 
+inline const CrawlStoreValue &CrawlStoreValue::operator [] (const store_key &key) const
+{
+    return get_table().get_value(key);
+}
+
 inline const CrawlStoreValue &CrawlStoreValue::operator [](const vec_size &index) const
 {
     return get_vector().get_value(index);
@@ -230,6 +230,8 @@ enum tag_minor_version
     TAG_MINOR_REMOVE_DECKS,        // Decks are no more
     TAG_MINOR_GAMESEEDS,           // Game seeds + rng state saved
     TAG_MINOR_GOLDIFY_MANUALS,     // Move manuals out of the inventory
+    TAG_MINOR_BULK_GRIDS,          // Level feature/property grids saved as blocks
+    TAG_MINOR_TRAVEL_TARGETS,      // Stair distances from travel targets cached
 #endif
     NUM_TAG_MINORS,
     TAG_MINOR_VERSION = NUM_TAG_MINORS - 1
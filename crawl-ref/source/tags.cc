@@ -102,19 +102,22 @@ extern set<pair<string, level_id> > auto_unique_annotations;
 extern abyss_state abyssal_state;
 
 reader::reader(const string &_read_filename, int minorVersion)
-    : _filename(_read_filename), _chunk(0), _pbuf(nullptr), _read_offset(0),
-      _minorVersion(minorVersion), _safe_read(false)
+    : _filename(_read_filename), _chunk(0), _pbuf(nullptr), _pbuf_len(0),
+      _read_offset(0), _minorVersion(minorVersion), _safe_read(false),
+      _cbuf_pos(0), _cbuf_len(0)
 {
     _file       = fopen_u(_filename.c_str(), "rb");
     opened_file = !!_file;
 }
 
 reader::reader(package *save, const string &chunkname, int minorVersion)
-    : _file(0), _chunk(0), opened_file(false), _pbuf(0), _read_offset(0),
-     _minorVersion(minorVersion), _safe_read(false)
+    : _file(0), _chunk(0), opened_file(false), _pbuf(0), _pbuf_len(0),
+     _read_offset(0), _minorVersion(minorVersion), _safe_read(false),
+     _cbuf_pos(0), _cbuf_len(0)
 {
     ASSERT(save);
     _chunk = new chunk_reader(save, chunkname);
+    _cbuf.reset(new unsigned char[TAG_CHUNK_BUFFER_SIZE]);
 }
 
 reader::~reader()
@@ -146,7 +149,7 @@ void reader::advance(size_t offset)
 bool reader::valid() const
 {
     return (_file && !feof(_file)) ||
-           (_pbuf && _read_offset < _pbuf->size());
+           (_pbuf && _read_offset < _pbuf_len);
 }
 
 static NORETURN void _short_read(bool safe_read)
@@ -170,16 +173,15 @@ unsigned char reader::readByte()
     }
     else if (_chunk)
     {
-        unsigned char buf;
-        if (_chunk->read(&buf, 1) != 1)
+        if (_cbuf_pos == _cbuf_len && !fill_chunk_buffer())
             _short_read(_safe_read);
-        return buf;
+        return _cbuf[_cbuf_pos++];
     }
     else
     {
-        if (_read_offset >= _pbuf->size())
+        if (_read_offset >= _pbuf_len)
             _short_read(_safe_read);
-        return (*_pbuf)[_read_offset++];
+        return _pbuf[_read_offset++];
     }
 }
 
@@ -197,20 +199,50 @@ void reader::read(void *data, size_t size)
     }
     else if (_chunk)
     {
-        if (_chunk->read(data, size) != size)
-            _short_read(_safe_read);
+        unsigned char *out = static_cast<unsigned char *>(data);
+        while (size)
+        {
+            if (_cbuf_pos == _cbuf_len)
+            {
+                // Big reads go straight to the caller's memory.
+                if (out && size >= TAG_CHUNK_BUFFER_SIZE)
+                {
+                    if (_chunk->read(out, size) != size)
+                        _short_read(_safe_read);
+                    return;
+                }
+                if (!fill_chunk_buffer())
+                    _short_read(_safe_read);
+            }
+
+            const size_t len = min(size, _cbuf_len - _cbuf_pos);
+            if (out)
+            {
+                memcpy(out, _cbuf.get() + _cbuf_pos, len);
+                out += len;
+            }
+            _cbuf_pos += len;
+            size -= len;
+        }
     }
     else
     {
-        if (_read_offset+size > _pbuf->size())
+        if (_read_offset+size > _pbuf_len)
             _short_read(_safe_read);
         if (data && size)
-            memcpy(data, &(*_pbuf)[_read_offset], size);
+            memcpy(data, _pbuf + _read_offset, size);
 
         _read_offset += size;
     }
 }
 
+bool reader::fill_chunk_buffer()
+{
+    _cbuf_pos = 0;
+    _cbuf_len = _chunk->read(_cbuf.get(), TAG_CHUNK_BUFFER_SIZE);
+    return _cbuf_len;
+}
+
 int reader::getMinorVersion() const
 {
     ASSERT(_minorVersion != TAG_MINOR_INVALID);
@@ -225,14 +257,23 @@ void reader::setMinorVersion(int minorVersion)
 void reader::fail_if_not_eof(const string &name)
 {
     char dummy;
-    if (_chunk ? _chunk->read(&dummy, 1) :
+    if (_chunk ? _cbuf_pos < _cbuf_len || _chunk->read(&dummy, 1) :
         _file ? (fgetc(_file) != EOF) :
-        _read_offset >= _pbuf->size())
+        _read_offset >= _pbuf_len)
     {
         fail("Incomplete read of \"%s\" - aborting.", name.c_str());
     }
 }
 
+writer::~writer()
+{
+    if (_chunk)
+    {
+        flush_chunk();
+        delete _chunk;
+    }
+}
+
 void writer::check_ok(bool ok)
 {
     if (!ok && !failed)
@@ -249,7 +290,11 @@ void writer::writeByte(unsigned char ch)
         return;
 
     if (_chunk)
-        _chunk->write(&ch, 1);
+    {
+        if (_cbuf_len == TAG_CHUNK_BUFFER_SIZE)
+            flush_chunk();
+        _cbuf[_cbuf_len++] = ch;
+    }
     else if (_file)
         check_ok(fputc(ch, _file) != EOF);
     else
@@ -262,7 +307,19 @@ void writer::write(const void *data, size_t size)
         return;
 
     if (_chunk)
-        _chunk->write(data, size);
+    {
+        if (_cbuf_len + size > TAG_CHUNK_BUFFER_SIZE)
+        {
+            flush_chunk();
+            if (size >= TAG_CHUNK_BUFFER_SIZE)
+            {
+                _chunk->write(data, size);
+                return;
+            }
+        }
+        memcpy(_cbuf.get() + _cbuf_len, data, size);
+        _cbuf_len += size;
+    }
     else if (_file)
         check_ok(fwrite(data, 1, size, _file) == size);
     else
@@ -272,6 +329,13 @@ void writer::write(const void *data, size_t size)
     }
 }
 
+void writer::flush_chunk()
+{
+    if (_cbuf_len)
+        _chunk->write(_cbuf.get(), _cbuf_len);
+    _cbuf_len = 0;
+}
+
 long writer::tell()
 {
     ASSERT(!_chunk);
@@ -798,6 +862,51 @@ static void _run_length_decode(reader &th, unmarshall um, grid &g,
     }
 }
 
+// Pack an unsigned value of the given width in network order, exactly as
+// marshallShort() or marshallInt() would write it.
+static inline void _pack_bytes(unsigned char *&p, uint32_t value, int bytes)
+{
+    for (int b = bytes - 1; b >= 0; --b)
+        *p++ = (value >> (8 * b)) & 0xFF;
+}
+
+static inline uint32_t _unpack_bytes(const unsigned char *&p, int bytes)
+{
+    uint32_t value = 0;
+    for (int b = 0; b < bytes; ++b)
+        value = (value << 8) | *p++;
+    return value;
+}
+
+// Marshall one integer field of every cell of a grid, in the same x-major
+// order as a nested per-cell loop, but with a single write per column.
+template <int BYTES, typename T, int X, int Y, typename getter>
+static void _marshall_grid(writer &th, const FixedArray<T, X, Y> &g,
+                           getter get)
+{
+    unsigned char col[Y * BYTES];
+    for (int x = 0; x < X; ++x)
+    {
+        unsigned char *p = col;
+        for (int y = 0; y < Y; ++y)
+            _pack_bytes(p, get(g[x][y]), BYTES);
+        th.write(col, sizeof(col));
+    }
+}
+
+template <int BYTES, typename T, int X, int Y, typename setter>
+static void _unmarshall_grid(reader &th, FixedArray<T, X, Y> &g, setter set)
+{
+    unsigned char col[Y * BYTES];
+    for (int x = 0; x < X; ++x)
+    {
+        th.read(col, sizeof(col));
+        const unsigned char *p = col;
+        for (int y = 0; y < Y; ++y)
+            set(g[x][y], _unpack_bytes(p, BYTES));
+    }
+}
+
 union float_marshall_kludge
 {
     float    f_num;
@@ -1217,6 +1326,7 @@ static void _shunt_monsters_out_of_walls()
                          m.pos().x, m.pos().y);
                     env.mgrid(m.pos()) = NON_MONSTER;
                     m.position = *di;
+                    mons_index_moved(m);
                     env.mgrid(*di) = i;
                     break;
                 }
@@ -4304,13 +4414,15 @@ static void tag_construct_level(writer &th)
 
     CANARY;
 
+    // Map knowledge cells vary in length, so only the fixed-size grids can
+    // go out as blocks.
+    _marshall_grid<1>(th, grd,
+                      [](dungeon_feature_type feat) { return feat; });
+    _marshall_grid<4>(th, env.pgrid,
+                      [](const terrain_property_t &prop) { return prop.flags; });
     for (int count_x = 0; count_x < GXM; count_x++)
         for (int count_y = 0; count_y < GYM; count_y++)
-        {
-            marshallByte(th, grd[count_x][count_y]);
             marshallMapCell(th, env.map_knowledge[count_x][count_y]);
-            marshallInt(th, env.pgrid[count_x][count_y].flags);
-        }
 
     marshallBoolean(th, !!env.map_forgotten);
     if (env.map_forgotten)
@@ -5706,18 +5818,25 @@ void tag_construct_level_tiles(writer &th)
     marshallShort(th, env.tile_default.floor);
     marshallShort(th, env.tile_default.special);
 
+    // Seven shorts per cell, packed a column at a time.
+    unsigned char col[GYM * 7 * 2];
     for (int count_x = 0; count_x < GXM; count_x++)
+    {
+        unsigned char *p = col;
         for (int count_y = 0; count_y < GYM; count_y++)
         {
-            marshallShort(th, env.tile_flv[count_x][count_y].wall_idx);
-            marshallShort(th, env.tile_flv[count_x][count_y].floor_idx);
-            marshallShort(th, env.tile_flv[count_x][count_y].feat_idx);
-
-            marshallShort(th, env.tile_flv[count_x][count_y].wall);
-            marshallShort(th, env.tile_flv[count_x][count_y].floor);
-            marshallShort(th, env.tile_flv[count_x][count_y].feat);
-            marshallShort(th, env.tile_flv[count_x][count_y].special);
+            const tile_flavour &flv = env.tile_flv[count_x][count_y];
+            _pack_bytes(p, flv.wall_idx, 2);
+            _pack_bytes(p, flv.floor_idx, 2);
+            _pack_bytes(p, flv.feat_idx, 2);
+
+            _pack_bytes(p, flv.wall, 2);
+            _pack_bytes(p, flv.floor, 2);
+            _pack_bytes(p, flv.feat, 2);
+            _pack_bytes(p, flv.special, 2);
         }
+        th.write(col, sizeof(col));
+    }
 
     marshallInt(th, TILE_WALL_MAX);
 }
@@ -5749,15 +5868,32 @@ static void tag_read_level(reader &th)
     EAT_CANARY;
 
     env.map_seen.reset();
+    mgrd.init(NON_MONSTER);
 #if TAG_MAJOR_VERSION == 34
     vector<coord_def> transporters;
+    const bool bulk_grids = th.getMinorVersion() >= TAG_MINOR_BULK_GRIDS;
+#else
+    const bool bulk_grids = true;
 #endif
+    if (bulk_grids)
+    {
+        const int minor = th.getMinorVersion();
+        _unmarshall_grid<1>(th, grd,
+            [minor](dungeon_feature_type &feat, uint32_t val)
+            {
+                feat = rewrite_feature(static_cast<dungeon_feature_type>(val),
+                                       minor);
+            });
+        _unmarshall_grid<4>(th, env.pgrid,
+            [](terrain_property_t &prop, uint32_t val) { prop.flags = val; });
+    }
+
     for (int i = 0; i < gx; i++)
         for (int j = 0; j < gy; j++)
         {
-            dungeon_feature_type feat = unmarshallFeatureType(th);
-            grd[i][j] = feat;
-            ASSERT(feat < NUM_FEATURES);
+            if (!bulk_grids)
+                grd[i][j] = unmarshallFeatureType(th);
+            ASSERT(grd[i][j] < NUM_FEATURES);
 
 #if TAG_MAJOR_VERSION == 34
             // Save these for potential destination clean up.
@@ -5774,9 +5910,8 @@ static void tag_read_level(reader &th)
             env.map_knowledge[i][j].flags &= ~MAP_VISIBLE_FLAG;
             if (env.map_knowledge[i][j].seen())
                 env.map_seen.set(i, j);
-            env.pgrid[i][j].flags = unmarshallInt(th);
-
-            mgrd[i][j] = NON_MONSTER;
+            if (!bulk_grids)
+                env.pgrid[i][j].flags = unmarshallInt(th);
         }
 
 #if TAG_MAJOR_VERSION == 34
@@ -6547,6 +6682,8 @@ static void tag_read_level_monsters(reader &th)
     {
         monster& m = menv[i];
         unmarshallMonster(th, m);
+        if (m.type != MONS_NO_MONSTER)
+            mons_index_add(m);
 
         // place monster
         if (!m.alive())
@@ -6708,19 +6845,26 @@ void tag_read_level_tiles(reader &th)
     env.tile_default.floor     = unmarshallShort(th);
     env.tile_default.special   = unmarshallShort(th);
 
+    ASSERT(gy == GYM);
+    unsigned char col[GYM * 7 * 2];
     for (int x = 0; x < gx; x++)
+    {
+        th.read(col, sizeof(col));
+        const unsigned char *p = col;
         for (int y = 0; y < gy; y++)
         {
-            env.tile_flv[x][y].wall_idx  = unmarshallShort(th);
-            env.tile_flv[x][y].floor_idx = unmarshallShort(th);
-            env.tile_flv[x][y].feat_idx  = unmarshallShort(th);
+            tile_flavour &flv = env.tile_flv[x][y];
+            flv.wall_idx  = _unpack_bytes(p, 2);
+            flv.floor_idx = _unpack_bytes(p, 2);
+            flv.feat_idx  = _unpack_bytes(p, 2);
 
             // These get overwritten by _regenerate_tile_flavour
-            env.tile_flv[x][y].wall    = unmarshallShort(th);
-            env.tile_flv[x][y].floor   = unmarshallShort(th);
-            env.tile_flv[x][y].feat    = unmarshallShort(th);
-            env.tile_flv[x][y].special = unmarshallShort(th);
+            flv.wall    = _unpack_bytes(p, 2);
+            flv.floor   = _unpack_bytes(p, 2);
+            flv.feat    = _unpack_bytes(p, 2);
+            flv.special = _unpack_bytes(p, 2);
         }
+    }
 
     _debug_count_tiles();
 
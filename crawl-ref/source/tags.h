@@ -6,6 +6,7 @@
 #pragma once
 
 #include <cstdio>
+#include <memory>
 
 #include "package.h"
 
@@ -32,27 +33,34 @@ enum tag_type   // used during save/load process to identify data blocks
  * writer API
  * *********************************************************************** */
 
+// Readers and writers of save chunks buffer this much at a time. The
+// buffer is only allocated for chunks; memory and FILE targets don't use it.
+static const size_t TAG_CHUNK_BUFFER_SIZE = 16384;
+
 class writer
 {
 public:
     writer(const string &filename, FILE* output, bool ignore_errors = false)
         : _filename(filename), _file(output), _chunk(0),
-          _ignore_errors(ignore_errors), _pbuf(0), failed(false)
+          _ignore_errors(ignore_errors), _pbuf(0), failed(false),
+          _cbuf_len(0)
     {
         ASSERT(output);
     }
     writer(vector<unsigned char>* poutput)
         : _filename(), _file(0), _chunk(0), _ignore_errors(false),
-          _pbuf(poutput), failed(false) { ASSERT(poutput); }
-    writer(package *save, const string &chunkname)
+          _pbuf(poutput), failed(false), _cbuf_len(0) { ASSERT(poutput); }
+    writer(package *save, const string &chunkname,
+           chunk_codec codec = CODEC_ZLIB)
         : _filename(), _file(0), _chunk(0), _ignore_errors(false),
-          failed(false)
+          failed(false), _cbuf_len(0)
     {
         ASSERT(save);
-        _chunk = save->writer(chunkname);
+        _chunk = save->writer(chunkname, codec);
+        _cbuf.reset(new unsigned char[TAG_CHUNK_BUFFER_SIZE]);
     }
 
-    ~writer() { if (_chunk) delete _chunk; }
+    ~writer();
 
     void writeByte(unsigned char byte);
     void write(const void *data, size_t size);
@@ -62,6 +70,7 @@ public:
 
 private:
     void check_ok(bool ok);
+    void flush_chunk();
 
 private:
     string _filename;
@@ -72,6 +81,11 @@ private:
     vector<unsigned char>* _pbuf;
 
     bool failed;
+
+    // Writes to a save chunk are collected here and passed on in large
+    // blocks, instead of one chunk_writer call per marshalled field.
+    unique_ptr<unsigned char[]> _cbuf;
+    size_t _cbuf_len;
 };
 
 void marshallByte    (writer &, int8_t);
@@ -99,11 +113,20 @@ public:
     reader(const string &filename, int minorVersion = TAG_MINOR_INVALID);
     reader(FILE* input, int minorVersion = TAG_MINOR_INVALID)
         : _file(input), _chunk(0), opened_file(false), _pbuf(0),
-          _read_offset(0), _minorVersion(minorVersion), _safe_read(false) {}
+          _pbuf_len(0), _read_offset(0), _minorVersion(minorVersion), _safe_read(false),
+          _cbuf_pos(0), _cbuf_len(0) {}
     reader(const vector<unsigned char>& input,
            int minorVersion = TAG_MINOR_INVALID)
-        : _file(0), _chunk(0), opened_file(false), _pbuf(&input),
-          _read_offset(0), _minorVersion(minorVersion), _safe_read(false) {}
+        : _file(0), _chunk(0), opened_file(false), _pbuf(input.data()),
+          _pbuf_len(input.size()), _read_offset(0),
+          _minorVersion(minorVersion), _safe_read(false), _cbuf_pos(0),
+          _cbuf_len(0) {}
+    // Reads from memory the caller keeps alive, e.g. a mapped file.
+    reader(const unsigned char *input, size_t len,
+           int minorVersion = TAG_MINOR_INVALID)
+        : _file(0), _chunk(0), opened_file(false), _pbuf(input),
+          _pbuf_len(len), _read_offset(0), _minorVersion(minorVersion),
+          _safe_read(false), _cbuf_pos(0), _cbuf_len(0) {}
     reader(package *save, const string &chunkname,
            int minorVersion = TAG_MINOR_INVALID);
     ~reader();
@@ -121,16 +144,26 @@ public:
 
     void set_safe_read(bool setting) { _safe_read = setting; }
 
+private:
+    bool fill_chunk_buffer();
+
 private:
     string _filename;
     FILE* _file;
     chunk_reader *_chunk;
     bool  opened_file;
-    const vector<unsigned char>* _pbuf;
-    unsigned int _read_offset;
+    const unsigned char* _pbuf;
+    size_t _pbuf_len;
+    size_t _read_offset;
     int _minorVersion;
     // always throw an exception rather than dying when reading past EOF
     bool _safe_read;
+
+    // Read-ahead from a save chunk, so that unmarshalling a field doesn't
+    // mean a trip through the decompressor for every byte.
+    unique_ptr<unsigned char[]> _cbuf;
+    size_t _cbuf_pos;
+    size_t _cbuf_len;
 };
 
 class short_read_exception : exception {};
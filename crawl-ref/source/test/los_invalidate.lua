@@ -0,0 +1,79 @@
+-- Check that the global LOS cache forgets exactly enough when terrain
+-- changes: cached cell_see_cell results must match a fresh LOS
+-- calculation after walls appear and disappear.
+
+local FAILMAP = 'losfail.map'
+
+local function check_los_from(cx, cy)
+  for y = -8, 8 do
+    for x = -8, 8 do
+      local px, py = cx + x, cy + y
+      if (x ~= 0 or y ~= 0) and dgn.in_bounds(px, py) then
+        local cached = los.cell_see_cell(cx, cy, px, py) == 1
+        local fresh = los.cell_see_cell_uncached(cx, cy, px, py)
+        if cached ~= fresh then
+          dgn.fprop_changed(px, py, "highlight")
+          debug.dump_map(FAILMAP)
+          assert(false,
+                 "stale global LOS from " .. dgn.point(cx, cy) .. " to "
+                   .. dgn.point(px, py) .. ": cached " .. tostring(cached)
+                   .. ", fresh " .. tostring(fresh)
+                   .. ". Map saved to " .. FAILMAP)
+        end
+      end
+    end
+  end
+end
+
+local function random_cell_near(cx, cy)
+  for tries = 1, 50 do
+    local x, y = cx + crawl.random_range(-8, 8), cy + crawl.random_range(-8, 8)
+    if dgn.in_bounds(x, y) then
+      return x, y
+    end
+  end
+  return cx, cy
+end
+
+local function toggle_wall(x, y)
+  local you_x, you_y = you.pos()
+  if (x == you_x and y == you_y) or dgn.mons_at(x, y) then
+    return
+  end
+  local feat = dgn.feature_name(dgn.grid(x, y))
+  if feat == "floor" then
+    dgn.terrain_changed(x, y, "rock_wall", false, false)
+  elseif feat == "rock_wall" then
+    dgn.terrain_changed(x, y, "floor", false, false)
+  end
+end
+
+local function test_invalidation()
+  you.random_teleport()
+  local you_x, you_y = you.pos()
+
+  local centers = { { you_x, you_y } }
+  for i = 1, 8 do
+    table.insert(centers, { random_cell_near(you_x, you_y) })
+  end
+
+  -- Fill the cache, then change terrain between cached cells.
+  for _, c in ipairs(centers) do
+    check_los_from(unpack(c))
+  end
+  for i = 1, 10 do
+    toggle_wall(random_cell_near(you_x, you_y))
+    for _, c in ipairs(centers) do
+      check_los_from(unpack(c))
+    end
+  end
+end
+
+for depth = 1, 6 do
+  debug.goto_place("D:" .. depth)
+  debug.flush_map_memory()
+  debug.generate_level()
+  for i = 1, 3 do
+    test_invalidation()
+  end
+end
@@ -101,6 +101,14 @@ void TilesFramework::shutdown()
     if (m_sock_name.empty())
         return;
 
+    // Give receivers a few seconds to take what is still queued.
+    for (int tries = 0; tries < 500 && _output_pending(); ++tries)
+    {
+        _send_queued();
+        if (_output_pending())
+            usleep(10 * 1000);
+    }
+
     close(m_sock);
     remove(m_sock_name.c_str());
 }
@@ -180,8 +188,7 @@ void TilesFramework::finish_message()
     if (m_msg_buf.size() == 0)
         return;
 #ifdef DEBUG_WEBSOCKETS
-    const int initial_buf_size = m_msg_buf.size();
-    fprintf(stderr, "websocket: About to send %d bytes.\n", initial_buf_size);
+    fprintf(stderr, "websocket: Queueing %d bytes.\n", (int) m_msg_buf.size());
 #endif
 
     if (m_sock_name.empty())
@@ -191,82 +198,138 @@ void TilesFramework::finish_message()
     }
 
     m_msg_buf.append("\n");
-    const char* fragment_start = m_msg_buf.data();
-    const char* data_end = m_msg_buf.data() + m_msg_buf.size();
-    int fragments = 0;
-    while (fragment_start < data_end)
+    auto msg = make_shared<const string>(move(m_msg_buf));
+    for (Destination &dest : m_dests)
     {
-        int fragment_size = data_end - fragment_start;
-        if (fragment_size > m_max_msg_size)
-            fragment_size = m_max_msg_size;
-        fragments++;
+        dest.queue.push_back(msg);
+        dest.queued_bytes += msg->size();
+    }
+    m_msg_buf.clear();
+    m_need_flush = true;
+
+    _send_queued();
+}
 
-        for (unsigned int i = 0; i < m_dest_addrs.size(); ++i)
+TilesFramework::Destination::Destination(const sockaddr_un &addr_,
+                                         bool binary_map_)
+    : addr(addr_), binary_map(binary_map_), sent(0), queued_bytes(0),
+      needs_resync(false)
+{
+}
+
+// Sends as much of dest's queue as its socket will take without blocking.
+// Returns false if the other side has gone away.
+bool TilesFramework::_send_to(Destination &dest)
+{
+    while (!dest.queue.empty())
+    {
+        const string &msg = *dest.queue.front();
+        const int fragment_size = min<size_t>(msg.size() - dest.sent,
+                                              m_max_msg_size);
+        ssize_t retval = sendto(m_sock, msg.data() + dest.sent, fragment_size,
+                                MSG_DONTWAIT, (sockaddr*) &dest.addr,
+                                sizeof(sockaddr_un));
+        if (retval <= 0)
         {
-            int retries = 30;
-            ssize_t sent = 0;
-            while (sent < fragment_size)
+            if (retval < 0 && errno == EINTR)
+                continue;
+            if (retval == 0 || errno == ENOBUFS || errno == EWOULDBLOCK
+                || errno == EAGAIN)
             {
-                ssize_t retval = sendto(m_sock, fragment_start + sent,
-                    fragment_size - sent, 0, (sockaddr*) &m_dest_addrs[i],
-                    sizeof(sockaddr_un));
-#ifdef DEBUG_WEBSOCKETS
-                fprintf(stderr,
-                            "    trying to send fragment to client %d...", i);
-#endif
-                if (retval <= 0)
-                {
-                    const char *errmsg = retval == 0 ? "No bytes sent"
-                                                     : strerror(errno);
-                    if (--retries <= 0)
-                        die("Socket write error: %s", errmsg);
-
-                    if (retval == 0 || errno == ENOBUFS || errno == EWOULDBLOCK
-                        || errno == EINTR || errno == EAGAIN)
-                    {
-                        // Wait for half a second at first (up to five), then
-                        // try again.
-                        const int sleep_time = retries > 25 ? 2 * 1000
-                                             : retries > 10 ? 500 * 1000
-                                             : 5000 * 1000;
 #ifdef DEBUG_WEBSOCKETS
-                        fprintf(stderr, "failed (%s), sleeping for %dms.\n",
-                                                    errmsg, sleep_time / 1000);
+                fprintf(stderr, "websocket: Socket busy, %d bytes queued.\n",
+                        (int) dest.queued_bytes);
 #endif
-                        usleep(sleep_time);
-                    }
-                    else if (errno == ECONNREFUSED || errno == ENOENT)
-                    {
-                        // the other side is dead
-#ifdef DEBUG_WEBSOCKETS
-                        fprintf(stderr,
-                            "failed (%s), breaking.\n", errmsg);
-#endif
-                        m_dest_addrs.erase(m_dest_addrs.begin() + i);
-                        i--;
-                        break;
-                    }
-                    else
-                        die("Socket write error: %s", errmsg);
-                }
-                else
-                {
+                return true;
+            }
+            if (errno == ECONNREFUSED || errno == ENOENT)
+            {
 #ifdef DEBUG_WEBSOCKETS
-                    fprintf(stderr, "fragment size %d sent.\n", fragment_size);
+                fprintf(stderr, "websocket: Receiver gone (%s).\n",
+                        strerror(errno));
 #endif
-                    sent += retval;
-                }
+                return false;
             }
+            die("Socket write error: %s", strerror(errno));
         }
 
-        fragment_start += fragment_size;
+        dest.sent += retval;
+        if (dest.sent == msg.size())
+        {
+            dest.queued_bytes -= msg.size();
+            dest.queue.pop_front();
+            dest.sent = 0;
+        }
     }
-    m_msg_buf.clear();
-    m_need_flush = true;
+    return true;
+}
+
+// Push queued output to every receiver without waiting on any of them. A
+// receiver that falls more than MAX_QUEUED_BYTES behind loses its backlog
+// and gets a full resend of the game state once it catches up, so a slow
+// spectator can't hold up the game.
+void TilesFramework::_send_queued()
+{
+    for (unsigned int i = 0; i < m_dests.size(); ++i)
+    {
+        Destination &dest = m_dests[i];
+        if (!_send_to(dest))
+        {
+            m_dests.erase(m_dests.begin() + i);
+            i--;
+            continue;
+        }
+
+        if (dest.queued_bytes > MAX_QUEUED_BYTES)
+        {
+            // Keep a partially sent message, so the receiver doesn't see
+            // half of it glued to the next one.
+            const bool partial = dest.sent > 0;
+            auto front = dest.queue.front();
+            dest.queue.clear();
+            dest.queued_bytes = 0;
+            if (partial)
+            {
+                dest.queue.push_back(front);
+                dest.queued_bytes = front->size();
+            }
+            dest.needs_resync = true;
 #ifdef DEBUG_WEBSOCKETS
-    fprintf(stderr, "websocket: Sent %d bytes in %d fragments.\n",
-                                                initial_buf_size, fragments);
+            fprintf(stderr, "websocket: Receiver %d lagging, dropped its "
+                            "backlog.\n", i);
 #endif
+        }
+    }
+}
+
+bool TilesFramework::_output_pending() const
+{
+    for (const Destination &dest : m_dests)
+        if (!dest.queue.empty())
+            return true;
+    return false;
+}
+
+// Called while waiting for input: if a receiver that dropped its backlog
+// has caught up, resend everything, just as for a joining spectator.
+void TilesFramework::_resync_lagging()
+{
+    bool resync = false;
+    for (Destination &dest : m_dests)
+    {
+        if (dest.needs_resync && dest.queue.empty())
+        {
+            dest.needs_resync = false;
+            resync = true;
+        }
+    }
+
+    if (resync)
+    {
+        flush_messages();
+        _send_everything();
+        flush_messages();
+    }
 }
 
 void TilesFramework::send_message(const char *format, ...)
@@ -309,7 +372,7 @@ void TilesFramework::_await_connection()
     if (m_sock_name.empty())
         return;
 
-    while (m_dest_addrs.size() == 0)
+    while (m_dests.size() == 0)
         _receive_control_message();
 }
 
@@ -361,8 +424,11 @@ wint_t TilesFramework::_handle_control_message(sockaddr_un addr, string data)
     {
         JsonWrapper primary = json_find_member(obj.node, "primary");
         primary.check(JSON_BOOL);
+        JsonWrapper binary_map = json_find_member(obj.node, "binary_map");
 
-        m_dest_addrs.push_back(addr);
+        m_dests.emplace_back(addr, binary_map.node
+                                   && binary_map->tag == JSON_BOOL
+                                   && binary_map->bool_);
         m_controlled_from_web = primary->bool_;
     }
     else if (msgtype == "key")
@@ -454,8 +520,15 @@ bool TilesFramework::await_input(wint_t& c, bool block)
 
             if (block)
             {
+                _resync_lagging();
                 tiles.flush_messages();
-                result = select(maxfd + 1, &fds, nullptr, nullptr, nullptr);
+
+                // Keep pushing queued output while we wait.
+                timeval retry;
+                retry.tv_sec = 0;
+                retry.tv_usec = 20 * 1000;
+                result = select(maxfd + 1, &fds, nullptr, nullptr,
+                                _output_pending() ? &retry : nullptr);
             }
             else
             {
@@ -469,7 +542,11 @@ bool TilesFramework::await_input(wint_t& c, bool block)
         while (result == -1 && errno == EINTR);
 
         if (result == 0)
-            return false;
+        {
+            if (!block)
+                return false;
+            _send_queued();
+        }
         else if (result > 0)
         {
             if (!m_sock_name.empty() && FD_ISSET(m_sock, &fds))
@@ -1276,6 +1353,252 @@ void TilesFramework::write_tileidx(tileidx_t t)
         tiles.write_message("[%d,%d]", lo, hi);
 }
 
+// Binary map frames. Cells that carry no monster and no doll are packed
+// into a compact byte stream instead of JSON objects; the client decodes
+// it into the same diffs in map_codec.js, which must be kept in sync.
+//
+// The stream starts with the origin offset and the row width, followed by
+// records of: cells skipped since the previous record, the number of
+// consecutive cells the record applies to, a field mask, and the fields
+// listed in the mask, in bit order.
+enum map_cell_field
+{
+    MCF_BG              = 1 << 0,
+    MCF_FG              = 1 << 1,
+    MCF_BASE            = 1 << 2,
+    MCF_FLV             = 1 << 3,
+    MCF_GLYPH           = 1 << 4,
+    MCF_COL             = 1 << 5,
+    MCF_FEAT            = 1 << 6,
+    MCF_MF              = 1 << 7,
+    MCF_CLOUD           = 1 << 8,
+    MCF_FLAGS           = 1 << 9,
+    MCF_HALO            = 1 << 10,
+    MCF_ORB_GLOW        = 1 << 11,
+    MCF_BLOOD_ROTATION  = 1 << 12,
+    MCF_TRAVEL_TRAIL    = 1 << 13,
+    MCF_OVERLAYS        = 1 << 14,
+};
+
+// Boolean tile properties, sent as a mask of changed flags and their values.
+enum map_cell_flag
+{
+    MCFL_BLOODY,
+    MCFL_OLD_BLOOD,
+    MCFL_SILENCED,
+    MCFL_HIGHLIGHTED_SUMMONER,
+    MCFL_MOLDY,
+    MCFL_GLOWING_MOLD,
+    MCFL_SANCTUARY,
+    MCFL_LIQUEFIED,
+    MCFL_QUAD_GLOW,
+    MCFL_DISJUNCT,
+    MCFL_MANGROVE_WATER,
+    MCFL_AWAKENED_FOREST,
+};
+
+static void _put_varint(string &out, uint64_t v)
+{
+    while (v >= 0x80)
+    {
+        out += (char) ((v & 0x7F) | 0x80);
+        v >>= 7;
+    }
+    out += (char) v;
+}
+
+static void _put_svarint(string &out, int64_t v)
+{
+    _put_varint(out, ((uint64_t) v << 1) ^ (uint64_t) (v >> 63));
+}
+
+static void _put_tileidx(string &out, tileidx_t t)
+{
+    _put_varint(out, t & 0xFFFFFFFF);
+    _put_varint(out, t >> 32);
+}
+
+static string _base64_encode(const string &in)
+{
+    static const char digits[] =
+        "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+    string out;
+    out.reserve((in.size() + 2) / 3 * 4);
+    for (size_t i = 0; i < in.size(); i += 3)
+    {
+        const size_t n = min<size_t>(3, in.size() - i);
+        uint32_t v = (uint8_t) in[i] << 16;
+        if (n > 1)
+            v |= (uint8_t) in[i + 1] << 8;
+        if (n > 2)
+            v |= (uint8_t) in[i + 2];
+
+        out += digits[v >> 18 & 0x3F];
+        out += digits[v >> 12 & 0x3F];
+        out += n > 1 ? digits[v >> 6 & 0x3F] : '=';
+        out += n > 2 ? digits[v & 0x3F] : '=';
+    }
+    return out;
+}
+
+bool TilesFramework::_use_binary_map() const
+{
+    if (m_dests.empty())
+        return false;
+    for (const Destination &dest : m_dests)
+        if (!dest.binary_map)
+            return false;
+    return true;
+}
+
+// The binary counterpart of _send_cell(), for cells without monsters and
+// with a foreground tile from the main tile pack. Appends nothing if the
+// cell is unchanged.
+void TilesFramework::_pack_cell(const screen_cell_t &current_sc,
+                                const screen_cell_t &next_sc,
+                                const map_cell &current_mc,
+                                const map_cell &next_mc,
+                                map_feature mf, bool force_full, string &out)
+{
+    const packed_cell &next_pc = next_sc.tile;
+    const packed_cell &current_pc = current_sc.tile;
+    const tileidx_t fg_idx = next_pc.fg & TILE_FLAG_MASK;
+    const char32_t glyph = next_sc.glyph;
+
+    int fields = 0;
+    if (next_pc.bg != current_pc.bg)
+        fields |= MCF_BG;
+    if (next_pc.fg != current_pc.fg)
+    {
+        fields |= MCF_FG;
+        if (fg_idx && fg_idx <= TILE_MAIN_MAX)
+            fields |= MCF_BASE;
+    }
+    if (_needs_flavour(next_pc)
+        && (next_pc.flv.floor != current_pc.flv.floor
+            || next_pc.flv.special != current_pc.flv.special
+            || !_needs_flavour(current_pc)
+            || force_full))
+    {
+        fields |= MCF_FLV;
+    }
+    if (current_sc.glyph != glyph)
+        fields |= MCF_GLYPH;
+    if ((current_sc.colour != next_sc.colour
+         || current_sc.glyph == ' ') && glyph != ' ')
+    {
+        fields |= MCF_COL;
+    }
+    if (current_mc.feat() != next_mc.feat())
+        fields |= MCF_FEAT;
+    if (get_cell_map_feature(current_mc) != mf)
+        fields |= MCF_MF;
+    if (next_pc.cloud != current_pc.cloud)
+        fields |= MCF_CLOUD;
+
+    // { new value, changed }
+    const bool flags[][2] =
+    {
+        { next_pc.is_bloody, next_pc.is_bloody != current_pc.is_bloody },
+        { next_pc.old_blood, next_pc.old_blood != current_pc.old_blood },
+        { next_pc.is_silenced,
+          next_pc.is_silenced != current_pc.is_silenced },
+        { next_pc.is_highlighted_summoner,
+          next_pc.is_highlighted_summoner
+              != current_pc.is_highlighted_summoner },
+        { next_pc.is_moldy, next_pc.is_moldy != current_pc.is_moldy },
+        { next_pc.glowing_mold,
+          next_pc.glowing_mold != current_pc.glowing_mold },
+        { next_pc.is_sanctuary,
+          next_pc.is_sanctuary != current_pc.is_sanctuary },
+        { next_pc.is_liquefied,
+          next_pc.is_liquefied != current_pc.is_liquefied },
+        { next_pc.quad_glow, next_pc.quad_glow != current_pc.quad_glow },
+        { next_pc.disjunct != 0, next_pc.disjunct != current_pc.disjunct },
+        { next_pc.mangrove_water,
+          next_pc.mangrove_water != current_pc.mangrove_water },
+        { next_pc.awakened_forest,
+          next_pc.awakened_forest != current_pc.awakened_forest },
+    };
+    COMPILE_CHECK(ARRAYSZ(flags) == MCFL_AWAKENED_FOREST + 1);
+    unsigned int changed_flags = 0, flag_values = 0;
+    for (unsigned int i = 0; i < ARRAYSZ(flags); ++i)
+    {
+        if (flags[i][0])
+            flag_values |= 1 << i;
+        if (flags[i][1])
+            changed_flags |= 1 << i;
+    }
+    if (changed_flags)
+        fields |= MCF_FLAGS;
+
+    if (next_pc.halo != current_pc.halo)
+        fields |= MCF_HALO;
+    if (next_pc.orb_glow != current_pc.orb_glow)
+        fields |= MCF_ORB_GLOW;
+    if (next_pc.blood_rotation != current_pc.blood_rotation)
+        fields |= MCF_BLOOD_ROTATION;
+    if (next_pc.travel_trail != current_pc.travel_trail)
+        fields |= MCF_TRAVEL_TRAIL;
+
+    bool overlays_changed =
+        next_pc.num_dngn_overlay != current_pc.num_dngn_overlay;
+    for (int i = 0; !overlays_changed && i < next_pc.num_dngn_overlay; i++)
+        if (next_pc.dngn_overlay[i] != current_pc.dngn_overlay[i])
+            overlays_changed = true;
+    if (overlays_changed)
+        fields |= MCF_OVERLAYS;
+
+    if (!fields)
+        return;
+
+    _put_varint(out, fields);
+    if (fields & MCF_BG)
+        _put_tileidx(out, next_pc.bg);
+    if (fields & MCF_FG)
+        _put_tileidx(out, next_pc.fg);
+    if (fields & MCF_BASE)
+        _put_varint(out, tileidx_known_base_item(fg_idx));
+    if (fields & MCF_FLV)
+    {
+        _put_varint(out, next_pc.flv.floor);
+        _put_varint(out, next_pc.flv.special);
+    }
+    if (fields & MCF_GLYPH)
+        _put_varint(out, glyph);
+    if (fields & MCF_COL)
+    {
+        const int col = next_sc.colour;
+        _put_svarint(out, (_get_brand(col) << 4) | macro_colour(col & 0xF));
+    }
+    if (fields & MCF_FEAT)
+        _put_varint(out, next_mc.feat());
+    if (fields & MCF_MF)
+        _put_varint(out, mf);
+    if (fields & MCF_CLOUD)
+        _put_tileidx(out, next_pc.cloud);
+    if (fields & MCF_FLAGS)
+    {
+        _put_varint(out, changed_flags);
+        _put_varint(out, flag_values);
+    }
+    if (fields & MCF_HALO)
+        _put_svarint(out, next_pc.halo);
+    if (fields & MCF_ORB_GLOW)
+        _put_varint(out, next_pc.orb_glow);
+    if (fields & MCF_BLOOD_ROTATION)
+        _put_svarint(out, next_pc.blood_rotation);
+    if (fields & MCF_TRAVEL_TRAIL)
+        _put_varint(out, next_pc.travel_trail);
+    if (fields & MCF_OVERLAYS)
+    {
+        _put_varint(out, next_pc.num_dngn_overlay);
+        for (int i = 0; i < next_pc.num_dngn_overlay; ++i)
+            _put_svarint(out, next_pc.dngn_overlay[i]);
+    }
+}
+
 void TilesFramework::_send_cell(const coord_def &gc,
                                 const screen_cell_t &current_sc, const screen_cell_t &next_sc,
                                 const map_cell &current_mc, const map_cell &next_mc,
@@ -1591,6 +1914,22 @@ void TilesFramework::_send_map(bool force_full)
     coord_def last_gc(0, 0);
     bool send_gc = true;
 
+    // Runs of consecutive cells with identical packed diffs are sent as a
+    // single record.
+    const bool binary = _use_binary_map();
+    string records, packed, run;
+    int run_start = 0, run_len = 0, last_end = 0;
+    auto flush_run = [&]()
+    {
+        if (!run_len)
+            return;
+        _put_varint(records, run_start - last_end);
+        _put_varint(records, run_len);
+        records += run;
+        last_end = run_start + run_len;
+        run_len = 0;
+    };
+
     json_open_array("cells");
     for (int y = 0; y < GYM; y++)
         for (int x = 0; x < GXM; x++)
@@ -1614,6 +1953,34 @@ void TilesFramework::_send_map(bool force_full)
             if (m_origin.equals(-1, -1))
                 m_origin = gc;
 
+            const screen_cell_t& sc = force_full ? default_cell
+                : m_current_view(gc);
+            const map_cell& mc = force_full ? default_map_cell
+                : m_current_map_knowledge(gc);
+            const map_cell& next_mc = env.map_knowledge(gc);
+
+            if (binary && !mc.monsterinfo() && !next_mc.monsterinfo()
+                && (m_next_view(gc).tile.fg & TILE_FLAG_MASK) < TILE_MAIN_MAX)
+            {
+                packed.clear();
+                _pack_cell(sc, m_next_view(gc), mc, next_mc,
+                           get_cell_map_feature(gc), force_full, packed);
+                if (packed.empty())
+                    continue;
+
+                const int index = y * GXM + x;
+                if (run_len && index == run_start + run_len && packed == run)
+                    run_len++;
+                else
+                {
+                    flush_run();
+                    run_start = index;
+                    run_len = 1;
+                    run = packed;
+                }
+                continue;
+            }
+
             json_open_object();
             if (send_gc
                 || last_gc.x + 1 != gc.x
@@ -1624,14 +1991,10 @@ void TilesFramework::_send_map(bool force_full)
                 json_treat_as_empty();
             }
 
-            const screen_cell_t& sc = force_full ? default_cell
-                : m_current_view(gc);
-            const map_cell& mc = force_full ? default_map_cell
-                : m_current_map_knowledge(gc);
             _send_cell(gc,
                        sc,
                        m_next_view(gc),
-                       mc, env.map_knowledge(gc),
+                       mc, next_mc,
                        new_monster_locs, force_full);
 
             if (!json_is_empty())
@@ -1643,6 +2006,21 @@ void TilesFramework::_send_map(bool force_full)
         }
     json_close_array(true);
 
+    flush_run();
+    if (!records.empty())
+    {
+        string frame;
+        _put_svarint(frame, -m_origin.x);
+        _put_svarint(frame, -m_origin.y);
+        _put_varint(frame, GXM);
+        frame += records;
+
+        json_write_name("bin");
+        m_msg_buf += '"';
+        m_msg_buf += _base64_encode(frame);
+        m_msg_buf += '"';
+    }
+
     json_close_object(true);
 
     finish_message();
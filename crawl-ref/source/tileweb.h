@@ -8,7 +8,9 @@
 #ifdef USE_TILE_WEB
 
 #include <bitset>
+#include <deque>
 #include <map>
+#include <memory>
 #include <sys/un.h>
 
 #include "cursor-type.h"
@@ -149,7 +151,7 @@ public:
     void send_message(PRINTF(1, ));
     void flush_messages();
 
-    bool has_receivers() { return !m_dest_addrs.empty(); }
+    bool has_receivers() { return !m_dests.empty(); }
     bool is_controlled_from_web() { return m_controlled_from_web; }
 
     /* Webtiles can receive input both via stdin, and on the
@@ -214,7 +216,27 @@ protected:
     int m_sock;
     int m_max_msg_size;
     string m_msg_buf;
-    vector<sockaddr_un> m_dest_addrs;
+
+    struct Destination
+    {
+        Destination(const sockaddr_un &addr, bool binary_map);
+
+        sockaddr_un addr;
+        bool binary_map; // asked for binary map frames when attaching
+
+        // Messages not yet fully sent; the first has been sent up to .sent
+        deque<shared_ptr<const string>> queue;
+        size_t sent;
+        size_t queued_bytes;
+        bool needs_resync;
+    };
+    vector<Destination> m_dests;
+    static const size_t MAX_QUEUED_BYTES = 4 * 1024 * 1024;
+    bool _use_binary_map() const;
+    bool _send_to(Destination &dest);
+    void _send_queued();
+    bool _output_pending() const;
+    void _resync_lagging();
 
     bool m_controlled_from_web;
     bool m_need_flush;
@@ -316,6 +338,9 @@ protected:
                     const map_cell &current_mc, const map_cell &next_mc,
                     map<uint32_t, coord_def>& new_monster_locs,
                     bool force_full);
+    void _pack_cell(const screen_cell_t &current_sc, const screen_cell_t &next_sc,
+                    const map_cell &current_mc, const map_cell &next_mc,
+                    map_feature mf, bool force_full, string &out);
     void _send_monster(const coord_def &gc, const monster_info* m,
                        map<uint32_t, coord_def>& new_monster_locs,
                        bool force_full);
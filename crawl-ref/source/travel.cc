@@ -35,6 +35,7 @@
 #include "format.h"
 #include "god-abil.h"
 #include "god-passive.h"
+#include "hash.h"
 #include "hints.h"
 #include "item-name.h"
 #include "item-prop.h"
@@ -512,6 +513,149 @@ static bool _is_safe_move(const coord_def& c)
     return _is_safe_cloud(c);
 }
 
+/////////////////////////////////////////////////////////////////////////////
+// Remembered travel floods
+//
+// Travel moves one step at a time towards a fixed destination (a travel
+// target, the next stair of interlevel travel, or the square explore chose),
+// and every step floods back from that destination until the player's
+// square is reached. The next step's flood would repeat the same work in
+// the same order, so we remember which square first reached each square,
+// together with what the flood saw of every square it looked at. As long
+// as none of those squares have changed, the flood towards the player's
+// new square would reach it from the remembered square again; otherwise
+// (or on a new level) we flood from scratch.
+//
+// Only find_travel_pos()'s step towards you.running.pos is remembered.
+// Explore's search for its next target floods out from the player, so its
+// result depends on where the player is and isn't reused; it only runs when
+// the previous explore target has been reached or has become invalid.
+
+struct travel_flood_memo
+{
+    level_id place;
+    coord_def target;
+    // False if the flood went through transporters, which we don't track.
+    bool usable;
+    // The square from which the flood first reached each square, if any.
+    FixedArray<coord_def, GXM, GYM> reached_from;
+    // Whether a square is already listed in seen.
+    FixedArray<bool, GXM, GYM> noted;
+    // The squares the flood looked at, and their _travel_memo_state.
+    vector<pair<coord_def, uint8_t>> seen;
+};
+
+static unique_ptr<travel_flood_memo> _travel_memo;
+
+// Everything the travel flood cares about when looking at a square.
+static uint8_t _travel_memo_state(const coord_def &c)
+{
+    return (_is_travelsafe_square(c) ? 1 : 0)
+           | _feature_traverse_cost(env.map_knowledge(c).feat()) << 1;
+}
+
+static travel_flood_memo *_new_travel_memo(const coord_def &target)
+{
+    if (!_travel_memo)
+        _travel_memo = make_unique<travel_flood_memo>();
+
+    travel_flood_memo &memo(*_travel_memo);
+    memo.place  = level_id::current();
+    memo.target = target;
+    memo.usable = true;
+    memo.reached_from.init(coord_def());
+    memo.noted.init(false);
+    memo.seen.clear();
+    return &memo;
+}
+
+class travel_flood_recorder : public travel_pathfind
+{
+public:
+    travel_flood_recorder() : memo(nullptr) { }
+
+    // Record the next floods into m; nullptr to stop recording.
+    void record_into(travel_flood_memo *m)
+    {
+        memo = m;
+    }
+
+protected:
+    bool point_traverse_delay(const coord_def &c) override
+    {
+        if (memo)
+        {
+            note_square(c);
+            if (grd(c) == DNGN_TRANSPORTER_LANDING)
+                memo->usable = false;
+        }
+        return travel_pathfind::point_traverse_delay(c);
+    }
+
+    bool path_flood(const coord_def &c, const coord_def &dc) override
+    {
+        if (!memo || !in_bounds(dc))
+            return travel_pathfind::path_flood(c, dc);
+
+        note_square(dc);
+        const bool unreached = !point_distance[dc.x][dc.y];
+        const bool found = travel_pathfind::path_flood(c, dc);
+        if (unreached && point_distance[dc.x][dc.y] > 0)
+            memo->reached_from(dc) = c;
+        return found;
+    }
+
+private:
+    void note_square(const coord_def &c)
+    {
+        if (!memo->noted(c))
+        {
+            memo->noted(c) = true;
+            memo->seen.emplace_back(c, _travel_memo_state(c));
+        }
+    }
+
+    travel_flood_memo *memo;
+};
+
+// If the last travel flood towards dest still applies, set move to the
+// square it would step to from youpos and return true.
+static bool _remembered_travel_move(const coord_def &youpos,
+                                    const coord_def &dest, coord_def &move)
+{
+    const travel_flood_memo *memo = _travel_memo.get();
+    if (!memo
+        || !memo->usable
+        || memo->target != dest
+        || memo->place != level_id::current()
+        || youpos == dest)
+    {
+        return false;
+    }
+
+    const coord_def from = memo->reached_from(youpos);
+    if (from.origin())
+        return false;
+
+    // Same setup as travel_pathfind::pathfind().
+    unwind_bool slime_wall_check(g_Slime_Wall_Check,
+                                 !actor_slime_wall_immune(&you));
+    unwind_slime_wall_precomputer slime_neighbours(g_Slime_Wall_Check);
+
+    if (!_is_travelsafe_square(dest))
+        return false;
+
+    for (const auto &entry : memo->seen)
+        if (_travel_memo_state(entry.first) != entry.second)
+            return false;
+
+    if (!_is_safe_move(from))
+        return false;
+
+    move = from;
+    return true;
+}
+
 void travel_init_load_level()
 {
     curr_excludes.clear();
@@ -531,6 +675,7 @@ void travel_init_new_level()
     travel_init_load_level();
 
     explore_stopped_pos.reset();
+    _travel_memo.reset();
 }
 
 // Given a dungeon feature description, returns the feature number. This is a
@@ -1723,7 +1868,9 @@ void find_travel_pos(const coord_def& youpos,
                      vector<coord_def>* features)
 {
     const bool need_move = move_x && move_y;
-    travel_pathfind tp;
+    // Only plain travel moves are remembered between steps.
+    const bool remember = need_move && !features;
+    travel_flood_recorder tp;
 
     if (need_move)
         tp.set_src_dst(youpos, you.running.pos);
@@ -1734,9 +1881,17 @@ void find_travel_pos(const coord_def& youpos,
 
     run_mode_type rmode = (need_move) ? RMODE_TRAVEL : RMODE_NOT_RUNNING;
 
-    coord_def dest = tp.pathfind(rmode, false);
-    if (dest.origin())
-        dest = tp.pathfind(rmode, true);
+    coord_def dest;
+    if (!remember || !_remembered_travel_move(youpos, you.running.pos, dest))
+    {
+        if (remember)
+            tp.record_into(_new_travel_memo(you.running.pos));
+        dest = tp.pathfind(rmode, false);
+        tp.record_into(nullptr);
+
+        if (dest.origin())
+            dest = tp.pathfind(rmode, true);
+    }
     coord_def new_dest = dest;
 
     // We'd either have to travel through a runed door, in which case we'll be
@@ -2981,31 +3136,64 @@ static int _find_transtravel_stair(const level_id &cur,
     return local_distance;
 }
 
+static void _set_curr_stairs(const level_pos &target,
+                             const vector<short> &distances)
+{
+    const vector<stair_info> &stairs =
+        travel_cache.get_level_info(target.id).get_stairs();
+    ASSERT(distances.size() == stairs.size());
+
+    curr_stairs.clear();
+    for (unsigned int i = 0; i < stairs.size(); ++i)
+    {
+        stair_info si = stairs[i];
+        si.distance = distances[i];
+        curr_stairs.push_back(si);
+    }
+}
+
 static bool _loadlev_populate_stair_distances(const level_pos &target)
 {
+    // Avoid loading the level if we remember the distances.
+    const LevelInfo &li = travel_cache.get_level_info(target.id);
+    if (const vector<short> *distances = li.get_target_distances(target.pos))
+    {
+        _set_curr_stairs(target, *distances);
+        return true;
+    }
+
     level_excursion excursion;
     excursion.go_to(target.id);
     _populate_stair_distances(target);
     return true;
 }
 
-static void _populate_stair_distances(const level_pos &target)
+// Returns the travel distances from pos on the current level to each of
+// the given stairs, -1 for those that can't be reached.
+static vector<short> _stair_distances_from(const coord_def &pos,
+                                           const vector<stair_info> &stairs)
 {
     // Populate travel_point_distance.
-    find_travel_pos(target.pos, nullptr, nullptr, nullptr);
+    find_travel_pos(pos, nullptr, nullptr, nullptr);
 
-    curr_stairs.clear();
-    for (stair_info si : travel_cache.get_level_info(target.id).get_stairs())
+    vector<short> distances;
+    for (const stair_info &si : stairs)
     {
-        si.distance = travel_point_distance[si.position.x][si.position.y];
-        if (!si.distance && target.pos != si.position
-            || si.distance < -1)
-        {
-            si.distance = -1;
-        }
-
-        curr_stairs.push_back(si);
+        int dist = travel_point_distance[si.position.x][si.position.y];
+        if (!dist && pos != si.position || dist < -1)
+            dist = -1;
+        distances.push_back(dist);
     }
+    return distances;
+}
+
+static void _populate_stair_distances(const level_pos &target)
+{
+    LevelInfo &li = travel_cache.get_level_info(target.id);
+    const vector<short> distances =
+        _stair_distances_from(target.pos, li.get_stairs());
+    li.set_target_distances(target.pos, distances);
+    _set_curr_stairs(target, distances);
 }
 
 static bool _find_transtravel_square(const level_pos &target, bool verbose)
@@ -3384,6 +3572,7 @@ void LevelInfo::update()
         !actor_slime_wall_immune(&you));
     precompute_travel_safety_grid travel_safety_calc;
     update_stair_distances();
+    update_target_distances();
 
     vector<coord_def> transporter_positions;
     get_transporters(transporter_positions);
@@ -3428,6 +3617,83 @@ void LevelInfo::update_stair_distances()
         set_distance_between_stairs(nstairs - 1, nstairs - 1, 0);
 }
 
+// A fingerprint of what the player can cross, which travel distances
+// depend on besides the level.
+static uint32_t _travel_abilities_stamp()
+{
+    vector<int> key(forbidden_terrain.begin(), forbidden_terrain.end());
+    key.push_back(player_likes_water(true));
+    key.push_back(have_passive(passive_t::water_walk));
+    key.push_back(you.permanent_flight());
+    key.push_back(you.species == SP_MERFOLK);
+    key.push_back(actor_slime_wall_immune(&you));
+    return hash32(key.data(), key.size() * sizeof(int));
+}
+
+// A fingerprint of what the distances from a square to the stairs depend on:
+// the known map, the stairs and the exclusions.
+uint32_t LevelInfo::target_distances_stamp() const
+{
+    vector<int> key;
+    key.reserve(GXM * GYM + stairs.size() * 2 + excludes.size() * 3);
+    for (rectangle_iterator ri(0); ri; ++ri)
+        key.push_back(env.map_knowledge(*ri).feat());
+    for (const stair_info &si : stairs)
+    {
+        key.push_back(si.position.x);
+        key.push_back(si.position.y);
+    }
+    for (const auto &entry : excludes)
+    {
+        key.push_back(entry.first.x);
+        key.push_back(entry.first.y);
+        key.push_back(entry.second.radius);
+    }
+    return hash32(key.data(), key.size() * sizeof(int));
+}
+
+// Find the distances from each waypoint on this level to the stairs, and
+// those from any other squares remembered, unless the level and what the
+// player can cross are as they were when they were last found.
+void LevelInfo::update_target_distances()
+{
+    vector<coord_def> targets;
+    for (const auto &entry : target_distances)
+        targets.push_back(entry.first);
+    for (int i = 0; i < TRAVEL_WAYPOINT_COUNT; ++i)
+    {
+        const level_pos &wp = travel_cache.get_waypoint(i);
+        if (wp.is_valid() && wp.id == id
+            && find(targets.begin(), targets.end(), wp.pos) == targets.end())
+        {
+            targets.push_back(wp.pos);
+        }
+    }
+
+    // Levels without waypoints, never travelled to, cost nothing.
+    if (targets.empty())
+        return;
+
+    const uint32_t stamp = target_distances_stamp();
+    const uint32_t abilities = _travel_abilities_stamp();
+    const bool current = stamp == target_stamp
+                         && abilities == target_abilities;
+    if (current && targets.size() == target_distances.size())
+        return;
+
+    vector<pair<coord_def, vector<short>>> found;
+    for (const coord_def &pos : targets)
+    {
+        const vector<short> *distances =
+            current ? get_target_distances(pos) : nullptr;
+        found.emplace_back(pos, distances ? *distances
+                                          : _stair_distances_from(pos, stairs));
+    }
+    target_distances.swap(found);
+    target_stamp = stamp;
+    target_abilities = abilities;
+}
+
 void LevelInfo::update_transporter(const coord_def& transpos,
                                    const coord_def& dest)
 {
@@ -3706,6 +3972,49 @@ void LevelInfo::resize_stair_distances()
     const int nstairs = stairs.size();
     stair_distances.reserve(nstairs * nstairs);
     stair_distances.resize(nstairs * nstairs, 0);
+
+    // These are indexed by stair, too.
+    target_distances.clear();
+}
+
+const vector<short> *LevelInfo::get_target_distances(const coord_def &pos)
+    const
+{
+    if (target_abilities != _travel_abilities_stamp())
+        return nullptr;
+
+    for (const auto &entry : target_distances)
+        if (entry.first == pos && entry.second.size() == stairs.size())
+            return &entry.second;
+    return nullptr;
+}
+
+// The distances must have been found on this level as it is now.
+void LevelInfo::set_target_distances(const coord_def &pos,
+                                     const vector<short> &distances)
+{
+    // Waypoints and the current travel target are all we really care
+    // about; keep a few more so that returning to a recent target is free.
+    const unsigned int max_targets = TRAVEL_WAYPOINT_COUNT + 4;
+
+    // Anything remembered so far was checked by the last update, unless the
+    // player can now cross different terrain; if there is nothing, this entry
+    // is the first for the map as it is now.
+    const uint32_t abilities = _travel_abilities_stamp();
+    if (abilities != target_abilities)
+        target_distances.clear();
+    if (target_distances.empty())
+    {
+        target_stamp = target_distances_stamp();
+        target_abilities = abilities;
+    }
+
+    erase_if(target_distances,
+             [&pos](const pair<coord_def, vector<short>> &entry)
+             { return entry.first == pos; });
+    if (target_distances.size() >= max_targets)
+        target_distances.erase(target_distances.begin());
+    target_distances.emplace_back(pos, distances);
 }
 
 int LevelInfo::distance_between(const stair_info *s1, const stair_info *s2)
@@ -3800,6 +4109,17 @@ void LevelInfo::save(writer& outf) const
     marshallByte(outf, NUM_DACTION_COUNTERS);
     for (int i = 0; i < NUM_DACTION_COUNTERS; i++)
         marshallShort(outf, daction_counters[i]);
+
+    marshallShort(outf, target_distances.size());
+    for (const auto &entry : target_distances)
+    {
+        marshallCoord(outf, entry.first);
+        ASSERT(entry.second.size() == stairs.size());
+        for (short dist : entry.second)
+            marshallShort(outf, dist);
+    }
+    marshallInt(outf, target_stamp);
+    marshallInt(outf, target_abilities);
 }
 
 void LevelInfo::load(reader& inf, int minorVersion)
@@ -3851,6 +4171,23 @@ void LevelInfo::load(reader& inf, int minorVersion)
     ASSERT_RANGE(n_count, 0, NUM_DACTION_COUNTERS + 1);
     for (int i = 0; i < n_count; i++)
         daction_counters[i] = unmarshallShort(inf);
+
+    target_distances.clear();
+#if TAG_MAJOR_VERSION == 34
+    if (minorVersion < TAG_MINOR_TRAVEL_TARGETS)
+        return;
+#endif
+    const int target_count = unmarshallShort(inf);
+    for (int i = 0; i < target_count; ++i)
+    {
+        const coord_def pos = unmarshallCoord(inf);
+        vector<short> distances;
+        for (int j = 0; j < stair_count; ++j)
+            distances.push_back(unmarshallShort(inf));
+        target_distances.emplace_back(pos, distances);
+    }
+    target_stamp = unmarshallInt(inf);
+    target_abilities = unmarshallInt(inf);
 }
 
 void LevelInfo::fixup()
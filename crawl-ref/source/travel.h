@@ -321,7 +321,8 @@ public:
 // Information on a level that interlevel travel needs.
 struct LevelInfo
 {
-    LevelInfo() : stairs(), excludes(), stair_distances(), id()
+    LevelInfo() : stairs(), excludes(), stair_distances(), target_stamp(0),
+                  target_abilities(0), id()
     {
         daction_counters.init(0);
     }
@@ -359,6 +360,12 @@ struct LevelInfo
     // or does not exist in our list of stairs, returns 0.
     int distance_between(const stair_info *s1, const stair_info *s2) const;
 
+    // Returns the travel distances from pos to each stair (in the order of
+    // get_stairs()), if we know them, else nullptr.
+    const vector<short> *get_target_distances(const coord_def &pos) const;
+    void set_target_distances(const coord_def &pos,
+                              const vector<short> &distances);
+
     void update_excludes();
     void update();              // Update LevelInfo to be correct for the
                                 // current level.
@@ -386,6 +393,8 @@ private:
     void correct_stair_list(const vector<coord_def> &s);
     void correct_transporter_list(const vector<coord_def> &s);
     void update_stair_distances();
+    void update_target_distances();
+    uint32_t target_distances_stamp() const;
     void sync_all_branch_stairs();
     void sync_branch_stairs(const stair_info *si);
     void set_distance_between_stairs(int a, int b, int dist);
@@ -399,6 +408,18 @@ private:
     exclude_set excludes;
 
     vector<short> stair_distances;  // Dist between stairs
+
+    // Distances from waypoints and other squares travelled to, to each
+    // stair, so that interlevel travel to them needn't load the level.
+    // Found for the waypoints whenever the level is updated, and for other
+    // squares when travel first needs them; most recently used last.
+    vector<pair<coord_def, vector<short>>> target_distances;
+    // target_distances_stamp() for the map target_distances are valid for.
+    uint32_t target_stamp;
+    // What the player could cross when target_distances were found; checked
+    // whenever they are used, since that can change away from the level.
+    uint32_t target_abilities;
+
     level_id id;
 
     friend class TravelCache;
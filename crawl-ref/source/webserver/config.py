@@ -149,6 +149,10 @@ max_idle_time = 5 * 60 * 60
 
 use_gzip = True
 
+# Ask crawl to send map updates as compact binary frames rather than JSON.
+# Crawl falls back to JSON while any attached server has not asked for them.
+binary_map_frames = True
+
 # Seconds until stale HTTP connections are closed
 # This needs a patch currently not in mainline tornado.
 http_connection_timeout = None
@@ -7,6 +7,7 @@ import warnings
 from datetime import datetime, timedelta
 from tornado.escape import json_encode
 
+import config
 from config import server_socket_path
 
 class WebtilesSocketConnection(object):
@@ -61,7 +62,8 @@ class WebtilesSocketConnection(object):
 
         msg = json_encode({
                 "msg": "attach",
-                "primary": primary
+                "primary": primary,
+                "binary_map": getattr(config, "binary_map_frames", False)
                 })
 
         self.open = True
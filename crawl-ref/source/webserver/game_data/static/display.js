@@ -1,6 +1,6 @@
-define(["jquery", "comm", "./map_knowledge", "./view_data", "./monster_list",
-        "./minimap", "./dungeon_renderer"],
-function ($, comm, map_knowledge, view_data, monster_list, minimap,
+define(["jquery", "comm", "./map_knowledge", "./map_codec", "./view_data",
+        "./monster_list", "./minimap", "./dungeon_renderer"],
+function ($, comm, map_knowledge, map_codec, view_data, monster_list, minimap,
           dungeon_renderer) {
     "use strict";
 
@@ -92,6 +92,9 @@ function ($, comm, map_knowledge, view_data, monster_list, minimap,
         if (data.cells)
             map_knowledge.merge(data.cells);
 
+        if (data.bin)
+            map_knowledge.merge(map_codec.decode(data.bin));
+
         // Mark cells overlapped by dirty cells as dirty
         $.each(map_knowledge.dirty().slice(), function (i, loc) {
             var cell = map_knowledge.get(loc.x, loc.y);
@@ -0,0 +1,169 @@
+define(["jquery"], function ($) {
+    "use strict";
+
+    // Decoder for binary map frames, see _pack_cell() in tileweb.cc.
+    // The bit assignments below must match map_cell_field and
+    // map_cell_flag there.
+    var MCF_BG             = 1 << 0,
+        MCF_FG             = 1 << 1,
+        MCF_BASE           = 1 << 2,
+        MCF_FLV            = 1 << 3,
+        MCF_GLYPH          = 1 << 4,
+        MCF_COL            = 1 << 5,
+        MCF_FEAT           = 1 << 6,
+        MCF_MF             = 1 << 7,
+        MCF_CLOUD          = 1 << 8,
+        MCF_FLAGS          = 1 << 9,
+        MCF_HALO           = 1 << 10,
+        MCF_ORB_GLOW       = 1 << 11,
+        MCF_BLOOD_ROTATION = 1 << 12,
+        MCF_TRAVEL_TRAIL   = 1 << 13,
+        MCF_OVERLAYS       = 1 << 14;
+
+    var flag_names = [
+        "bloody", "old_blood", "silenced", "highlighted_summoner", "moldy",
+        "glowing_mold", "sanctuary", "liquefied", "quad_glow", "disjunct",
+        "mangrove_water", "awakened_forest"
+    ];
+
+    function reader(data)
+    {
+        var bytes = atob(data);
+        var pos = 0;
+
+        function varint()
+        {
+            var result = 0, scale = 1, b;
+            do
+            {
+                b = bytes.charCodeAt(pos++);
+                result += (b & 0x7f) * scale;
+                scale *= 128;
+            } while (b & 0x80);
+            return result;
+        }
+
+        return {
+            done: function () { return pos >= bytes.length; },
+            varint: varint,
+            svarint: function () {
+                var v = varint();
+                return v % 2 ? -(v + 1) / 2 : v / 2;
+            },
+            // Same representation as TilesFramework::write_tileidx()
+            tileidx: function () {
+                var lo = varint() | 0;
+                var hi = varint() | 0;
+                return hi ? [lo, hi] : lo;
+            },
+        };
+    }
+
+    // Turns a binary frame into the list of cell diffs the JSON "cells"
+    // array would have contained.
+    function decode(data)
+    {
+        var r = reader(data);
+        var ox = r.svarint(), oy = r.svarint(), width = r.varint();
+        var cells = [];
+        var index = 0;
+
+        while (!r.done())
+        {
+            index += r.varint();
+            var count = r.varint();
+            var fields = r.varint();
+            var val = {}, t = {};
+            var has_t = false;
+
+            if (fields & MCF_BG)
+            {
+                t.bg = r.tileidx();
+                has_t = true;
+            }
+            if (fields & MCF_FG)
+            {
+                t.fg = r.tileidx();
+                t.doll = null;
+                t.mcache = null;
+                has_t = true;
+            }
+            if (fields & MCF_BASE)
+                t.base = r.varint();
+            if (fields & MCF_FLV)
+            {
+                t.flv = {f: r.varint()};
+                var s = r.varint();
+                if (s)
+                    t.flv.s = s;
+                has_t = true;
+            }
+            if (fields & MCF_GLYPH)
+                val.g = String.fromCodePoint(r.varint());
+            if (fields & MCF_COL)
+                val.col = r.svarint();
+            if (fields & MCF_FEAT)
+                val.f = r.varint();
+            if (fields & MCF_MF)
+                val.mf = r.varint();
+            if (fields & MCF_CLOUD)
+            {
+                t.cloud = r.tileidx();
+                has_t = true;
+            }
+            if (fields & MCF_FLAGS)
+            {
+                var changed = r.varint(), values = r.varint();
+                for (var i = 0; i < flag_names.length; ++i)
+                    if (changed & (1 << i))
+                        t[flag_names[i]] = !!(values & (1 << i));
+                has_t = true;
+            }
+            if (fields & MCF_HALO)
+            {
+                t.halo = r.svarint();
+                has_t = true;
+            }
+            if (fields & MCF_ORB_GLOW)
+            {
+                t.orb_glow = r.varint();
+                has_t = true;
+            }
+            if (fields & MCF_BLOOD_ROTATION)
+            {
+                t.blood_rotation = r.svarint();
+                has_t = true;
+            }
+            if (fields & MCF_TRAVEL_TRAIL)
+            {
+                t.travel_trail = r.varint();
+                has_t = true;
+            }
+            if (fields & MCF_OVERLAYS)
+            {
+                var n = r.varint();
+                t.ov = [];
+                for (var j = 0; j < n; ++j)
+                    t.ov.push(r.svarint());
+                has_t = true;
+            }
+
+            for (var k = 0; k < count; ++k, ++index)
+            {
+                // Each cell needs its own objects, since merging keeps them.
+                var cell = $.extend(true, {}, val);
+                if (has_t)
+                    cell.t = $.extend(true, {}, t);
+                cell.x = index % width + ox;
+                cell.y = Math.floor(index / width) + oy;
+                cells.push(cell);
+            }
+        }
+
+        return cells;
+    }
+
+    return {
+        decode: decode,
+    };
+});
@@ -149,6 +149,8 @@ static void _wizard_go_to_level(const level_pos &pos)
 
     // Tell stash-tracker and travel that we've changed levels.
     trackers_init_new_level(true);
+
+    pregen_background_step();
 }
 
 void wizard_interlevel_travel()
@@ -8,19 +8,30 @@
 #include "wiz-fsim.h"
 
 #include <cerrno>
+#include <cinttypes>
+#include <functional>
+#ifdef UNIX
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
 
 #include "beam.h"
 #include "bitary.h"
 #include "coordit.h"
 #include "dbg-util.h"
 #include "directn.h"
+#include "dungeon.h"
 #include "env.h"
 #include "fight.h"
+#include "initfile.h"
 #include "item-prop.h"
 #include "items.h"
 #include "item-use.h"
 #include "jobs.h"
 #include "libutil.h"
+#include "los.h"
 #include "makeitem.h"
 #include "message.h"
 #include "mgen-data.h"
@@ -29,16 +40,22 @@
 #include "mon-place.h"
 #include "monster.h"
 #include "mon-util.h"
+#include "newgame-def.h"
+#include "ng-setup.h"
 #include "options.h"
 #include "output.h"
 #include "player-equip.h"
 #include "player.h"
+#include "random.h"
 #include "ranged-attack.h"
 #include "skills.h"
 #include "species.h"
 #include "state.h"
 #include "stringutil.h"
+#include "tags.h"
+#include "terrain.h"
 #include "throw.h"
+#include "tileview.h"
 #include "unwind.h"
 #include "version.h"
 #include "wiz-you.h"
@@ -47,6 +64,10 @@
 
 typedef map<skill_type, int8_t> skill_map;
 
+// Set when running from the command line with -fsim: there is no screen to
+// redraw and no keyboard to poll, and progress goes to stdout.
+static bool _fsim_batch = false;
+
 static const char* _title_line =
     "Source | AvHitDam | MaxDam |  Acc | AvDam | AvTime | AvSpd | AvEffDam"; // 69 columns
 static const char* _tsv_title_line =
@@ -254,7 +275,8 @@ static bool _fsim_kit_equip(const string &kit, string &error)
         }
     }
 
-    redraw_screen();
+    if (!_fsim_batch)
+        redraw_screen();
     return true;
 }
 
@@ -305,7 +327,7 @@ static monster* _init_fsim()
         mon = create_monster(temp);
         if (!mon)
         {
-            mpr("Failed to create monster.");
+            mprf(MSGCH_ERROR, "Failed to create monster.");
             return nullptr;
         }
     }
@@ -323,7 +345,7 @@ static monster* _init_fsim()
     if (!adjacent(mon->pos(), you.pos()))
     {
         monster_die(*mon, KILL_DISMISSED, NON_MONSTER);
-        mpr("Could not put monster adjacent to player.");
+        mprf(MSGCH_ERROR, "Could not put monster adjacent to player.");
         return 0;
     }
 
@@ -333,7 +355,8 @@ static monster* _init_fsim()
     mon->hit_points = mon->max_hit_points = MAX_MONSTER_HP;
     mon->behaviour = BEH_SEEK;
 
-    redraw_screen();
+    if (!_fsim_batch)
+        redraw_screen();
 
     return mon;
 }
@@ -436,6 +459,10 @@ static fight_data _get_fight_data(monster &mon, int iter_limit, bool defend)
 
     // now make sure the player is ready
     unwind_var<int> exp_available(you.exp_available, 0);
+    // practising during the fights mustn't change how XL sweeps train later
+    unwind_var<list<skill_type>> exercises(you.exercises);
+    unwind_var<list<skill_type>> exercises_all(you.exercises_all);
+    unwind_var<FixedVector<unsigned int, NUM_SKILLS>> training(you.training);
 
     // disable death and delay, but make sure that these values
     // get reset when the function call ends
@@ -557,6 +584,237 @@ static string _init_scale(skill_map &scale, bool &xl_mode)
     return ret;
 }
 
+// Show a line of results: in the message area, or on stdout for -fsim.
+static void _fsim_show(const string &line)
+{
+    if (_fsim_batch)
+    {
+        printf("%s\n", line.c_str());
+        fflush(stdout);
+    }
+    else
+        mpr(line);
+}
+
+// Has the user hit escape to cancel the simulation?
+static bool _fsim_cancelled()
+{
+    return !_fsim_batch && kbhit() && getchk() == 27;
+}
+
+// Prepares the player for sweep point i. Anything random it does must be
+// seeded from the given seed, so that it doesn't depend on the earlier points.
+typedef function<void(int, uint64_t)> fsim_setup_fn;
+// Handles the result for sweep point i; returns false to stop the sweep.
+typedef function<bool(int, fight_data &)> fsim_report_fn;
+
+/**
+ * Set up and fight sweep point i. The RNG is seeded from the sweep's seed and
+ * the point, so the results are the same whichever process runs the point,
+ * and whichever points it ran before.
+ */
+static fight_data _fsim_point(monster &mon, bool defense, int i,
+                              const fsim_setup_fn &setup, uint64_t base_seed)
+{
+    seed_rng(base_seed + i);
+    setup(i, base_seed);
+    // Setting up a point can use more or less randomness depending on the
+    // points set up before it.
+    seed_rng(base_seed + i);
+    return _get_fight_data(mon, Options.fsim_rounds, defense);
+}
+
+static void _marshall_fight_stats(writer &th, const fight_damage_stats &stats)
+{
+    marshallInt(th, stats.cumulative_damage);
+    marshallInt(th, stats.time_taken);
+    marshallInt(th, stats.hits);
+    marshallInt(th, stats.iterations);
+    marshallInt(th, stats.max_dam);
+}
+
+static void _unmarshall_fight_stats(reader &th, fight_damage_stats &stats)
+{
+    stats.cumulative_damage = unmarshallInt(th);
+    stats.time_taken        = unmarshallInt(th);
+    stats.hits              = unmarshallInt(th);
+    stats.iterations        = unmarshallInt(th);
+    stats.max_dam           = unmarshallInt(th);
+    stats.calc_output_stats();
+}
+
+#ifdef UNIX
+struct fsim_worker
+{
+    pid_t pid;
+    FILE *results;
+};
+
+// Body of a forked worker: fight at every jobs'th sweep point, starting
+// with the job'th, and stream the raw counts back as each one finishes.
+NORETURN static void _fsim_worker(monster &mon, bool defense, int npoints,
+                                  const fsim_setup_fn &setup, int job,
+                                  int jobs, uint64_t base_seed, FILE *out)
+{
+    // Keep anything the game tries to draw off the terminal.
+    const int devnull = open("/dev/null", O_RDWR);
+    if (devnull != -1)
+    {
+        dup2(devnull, STDIN_FILENO);
+        dup2(devnull, STDOUT_FILENO);
+        close(devnull);
+    }
+    no_messages mx;
+
+    writer th("fight simulator results", out);
+    for (int i = job; i < npoints; i += jobs)
+    {
+        const fight_data fdata = _fsim_point(mon, defense, i, setup,
+                                             base_seed);
+        _marshall_fight_stats(th, fdata.player);
+        _marshall_fight_stats(th, fdata.monster);
+        fflush(out);
+    }
+    fclose(out);
+    // Don't run the parent's exit handlers.
+    _exit(0);
+}
+
+/**
+ * Deal the sweep points out round robin to SysEnv.jobs forked workers.
+ * Results are read back in point order, so report() sees the same
+ * sequence as in a serial sweep, and a cancel kills the workers.
+ *
+ * @return false if the workers couldn't be started; nothing has been
+ *         reported in that case.
+ */
+static bool _fsim_sweep_parallel(monster &mon, bool defense, int npoints,
+                                 const fsim_setup_fn &setup,
+                                 const fsim_report_fn &report,
+                                 uint64_t base_seed)
+{
+    const int jobs = min(SysEnv.jobs, npoints);
+
+    dprf("Simulating with %d workers (base seed %" PRIu64 ")", jobs,
+         base_seed);
+    fflush(stdout);
+    fflush(stderr);
+
+    vector<fsim_worker> workers;
+    for (int job = 0; job < jobs; ++job)
+    {
+        int fds[2];
+        if (pipe(fds))
+        {
+            perror("pipe");
+            break;
+        }
+
+        const pid_t pid = fork();
+        if (pid == -1)
+        {
+            perror("fork");
+            close(fds[0]);
+            close(fds[1]);
+            break;
+        }
+
+        if (!pid)
+        {
+            close(fds[0]);
+            for (const fsim_worker &worker : workers)
+                fclose(worker.results);
+            _fsim_worker(mon, defense, npoints, setup, job, jobs, base_seed,
+                         fdopen(fds[1], "wb"));
+        }
+
+        close(fds[1]);
+        workers.push_back({pid, fdopen(fds[0], "rb")});
+    }
+
+    const bool started = (int)workers.size() == jobs;
+    if (started)
+    {
+        vector<unique_ptr<reader>> readers;
+        for (const fsim_worker &worker : workers)
+        {
+            readers.emplace_back(new reader(worker.results));
+            readers.back()->set_safe_read(true);
+        }
+
+        for (int i = 0; i < npoints; ++i)
+        {
+            fight_data fdata;
+            try
+            {
+                reader &th = *readers[i % jobs];
+                _unmarshall_fight_stats(th, fdata.player);
+                _unmarshall_fight_stats(th, fdata.monster);
+            }
+            catch (short_read_exception &E)
+            {
+                mprf(MSGCH_ERROR, "Fight simulator worker %d died.",
+                     i % jobs + 1);
+                break;
+            }
+
+            clear_messages();
+            if (!report(i, fdata))
+                break;
+        }
+    }
+
+    // Workers that are still going are only left running after a cancel
+    // or a failure, and their results are no longer wanted.
+    for (const fsim_worker &worker : workers)
+    {
+        kill(worker.pid, SIGKILL);
+        fclose(worker.results);
+        waitpid(worker.pid, nullptr, 0);
+    }
+    return started;
+}
+#endif
+
+/**
+ * Run a fight at each of npoints sweep points, on -jobs worker processes
+ * if there are several.
+ *
+ * @param setup   Sets up the player's skills or XL for a point.
+ * @param report  Is given each point's results, in order.
+ */
+static void _fsim_sweep(monster &mon, bool defense, int npoints,
+                        const fsim_setup_fn &setup,
+                        const fsim_report_fn &report)
+{
+    const uint64_t base_seed = you.game_seed ? you.game_seed : get_uint64();
+
+    // Each point reseeds every generator, the level generation ones
+    // included. Put them all back afterwards, so that running the simulator
+    // in a seeded game changes neither the levels still to be built nor the
+    // game's own random numbers.
+    const CrawlVector rng_state = generators_to_vector();
+
+#ifdef UNIX
+    if (SysEnv.jobs > 1 && npoints > 1
+        && _fsim_sweep_parallel(mon, defense, npoints, setup, report,
+                                base_seed))
+    {
+        load_generators(rng_state);
+        return;
+    }
+#endif
+
+    for (int i = 0; i < npoints; ++i)
+    {
+        fight_data fdata = _fsim_point(mon, defense, i, setup, base_seed);
+        clear_messages();
+        if (!report(i, fdata))
+            break;
+    }
+    load_generators(rng_state);
+}
+
 static void _fsim_simple_scale(FILE * o, monster* mon, bool defense)
 {
     skill_map scale;
@@ -580,41 +838,60 @@ static void _fsim_simple_scale(FILE * o, monster* mon, bool defense)
             text_title;
 
     fprintf(o, "%s\n", file_title.c_str());
-    mpr(text_title);
+    _fsim_show(text_title);
 
-    vector<pair<int, fight_data>> results;
-    const int iter_limit = Options.fsim_rounds;
-    for (int i = xl_mode ? 1 : 0; i <= 27; i++)
-    {
-        clear_messages();
+    const int first = xl_mode ? 1 : 0;
+    // XL is gained one level at a time from 1, as the training weights
+    // spread the experience differently over bigger jumps.
+    if (xl_mode)
+        set_xl(first, true);
 
-        if (xl_mode)
-            set_xl(i, true);
-        else
+    vector<pair<int, fight_data>> results;
+    _fsim_sweep(*mon, defense, 28 - first,
+        [&](int point, uint64_t seed)
         {
-            for (const auto &entry : scale)
-                set_skill_level(entry.first, i / entry.second);
-        }
+            const int i = first + point;
+            if (xl_mode)
+            {
+                // Seed each level gained by the level, so that every
+                // process trains the same way on the way to level i.
+                while (you.experience_level < i)
+                {
+                    seed_rng(seed + you.experience_level + 1);
+                    set_xl(you.experience_level + 1, true);
+                }
+            }
+            else
+            {
+                for (const auto &entry : scale)
+                    set_skill_level(entry.first, i / entry.second);
+            }
+        },
+        [&](int point, fight_data &fdata)
+        {
+            const int i = first + point;
+            results.emplace_back(i, fdata);
+            fight_damage_stats &fstats = defense ? fdata.monster
+                                                 : fdata.player;
+            const string line = fstats.summary(make_stringf("%2d | ", i),
+                                               false);
+            const string file_line = Options.fsim_csv ?
+                    fstats.summary(make_stringf("%d\t", i), true) :
+                    line;
+            _fsim_show(line);
+            fprintf(o, "%s\n", file_line.c_str());
+            fflush(o);
 
-        fight_data fdata = _get_fight_data(*mon, iter_limit, defense);
-        results.emplace_back(i, fdata);
-        fight_damage_stats &fstats = defense ? fdata.monster : fdata.player;
-        const string line = fstats.summary(make_stringf("%2d | ", i), false);
-        const string file_line = Options.fsim_csv ?
-                fstats.summary(make_stringf("%d\t", i), true) :
-                line;
-        mpr(line);
-        fprintf(o, "%s\n", file_line.c_str());
-        fflush(o);
+            // kill the loop if the user hits escape
+            if (_fsim_cancelled())
+            {
+                mpr("Cancelling simulation.\n");
+                fprintf(o, "Simulation cancelled!\n\n");
+                return false;
+            }
+            return true;
+        });
 
-        // kill the loop if the user hits escape
-        if (kbhit() && getchk() == 27)
-        {
-            mpr("Cancelling simulation.\n");
-            fprintf(o, "Simulation cancelled!\n\n");
-            break;
-        }
-    }
     // if there was any retaliatory damage, report that. Don't report a row if
     // there were no hits; for attacking most monsters would have all 0s here.
     for (auto &fdata : results)
@@ -628,7 +905,7 @@ static void _fsim_simple_scale(FILE * o, monster* mon, bool defense)
             const string file_line = Options.fsim_csv ?
                     fstats.summary(make_stringf("%d\t", i), true) :
                     line;
-            mpr(line);
+            _fsim_show(line);
             fprintf(o, "%s\n", file_line.c_str());
             fflush(o);
         }
@@ -656,39 +933,54 @@ static void _fsim_double_scale(FILE * o, monster* mon, bool defense)
 
     fprintf(o,"\n");
 
-    const int iter_limit = Options.fsim_rounds;
-    for (int y = 1; y <= 27; y += 2)
-    {
-        fprintf(o, Options.fsim_csv ? "%d\t" : "%2d", y);
-        for (int x = 1; x <= 27; x += 2)
+    // Skill levels 1, 3, ..., 27 on each axis, x varying fastest.
+    const int steps = 14;
+    bool cancelled = false;
+    _fsim_sweep(*mon, defense, steps * steps,
+        [&](int point, uint64_t)
         {
-            clear_messages();
-            set_skill_level(skx, x);
-            set_skill_level(sky, y);
-            fight_data fdata = _get_fight_data(*mon, iter_limit, defense);
-            fight_damage_stats &fstats = defense ? fdata.monster : fdata.player;
-            mprf("%s %d, %s %d: %d", skill_name(skx), x, skill_name(sky), y,
-                 int(fstats.av_eff_dam));
+            set_skill_level(skx, point % steps * 2 + 1);
+            set_skill_level(sky, point / steps * 2 + 1);
+        },
+        [&](int point, fight_data &fdata)
+        {
+            const int x = point % steps * 2 + 1;
+            const int y = point / steps * 2 + 1;
+            if (x == 1)
+                fprintf(o, Options.fsim_csv ? "%d\t" : "%2d", y);
+
+            fight_damage_stats &fstats = defense ? fdata.monster
+                                                 : fdata.player;
+            _fsim_show(make_stringf("%s %d, %s %d: %d", skill_name(skx), x,
+                                    skill_name(sky), y,
+                                    int(fstats.av_eff_dam)));
             fprintf(o,Options.fsim_csv ? "%.1f\t" : "%5.1f", fstats.av_eff_dam);
+            if (x == 27)
+                fprintf(o,"\n");
             fflush(o);
 
             // kill the loop if the user hits escape
-            if (kbhit() && getchk() == 27)
+            if (_fsim_cancelled())
             {
-                mpr("Cancelling simulation.\n");
-                fprintf(o, "\nSimulation cancelled!\n\n");
-                return;
+                cancelled = true;
+                return false;
             }
-        }
-        fprintf(o,"\n");
+            return true;
+        });
+
+    if (cancelled)
+    {
+        mpr("Cancelling simulation.\n");
+        fprintf(o, "\nSimulation cancelled!\n\n");
     }
 }
 
-void wizard_fight_sim(bool double_scale)
+/// @return whether the simulation ran to the end.
+bool wizard_fight_sim(bool double_scale)
 {
     monster * mon = _init_fsim();
     if (!mon)
-        return;
+        return false;
 
     bool defense = false;
     // TODO: why is this a .csv file? It's not a CSV.
@@ -699,7 +991,7 @@ void wizard_fight_sim(bool double_scale)
     {
         mprf(MSGCH_ERROR, "Can't write %s: %s", fightstat, strerror(errno));
         _uninit_fsim(mon);
-        return;
+        return false;
     }
 
     if (Options.fsim_mode.find("defen") != string::npos)
@@ -727,7 +1019,7 @@ void wizard_fight_sim(bool double_scale)
             canned_msg(MSG_OK);
             fclose(o);
             _uninit_fsim(mon);
-            return;
+            return false;
         }
     }
 
@@ -748,6 +1040,7 @@ void wizard_fight_sim(bool double_scale)
     crawl_state.disables.set(DIS_DEATH);
     crawl_state.disables.set(DIS_DELAY);
 
+    bool completed = true;
     void (*fsim_proc)(FILE * o, monster* mon, bool defense) = nullptr;
     fsim_proc = double_scale ? _fsim_double_scale : _fsim_simple_scale;
 
@@ -765,9 +1058,10 @@ void wizard_fight_sim(bool double_scale)
             }
             else
             {
-                mprf("Aborting sim on %s", kit.c_str());
+                mprf(MSGCH_ERROR, "Aborting sim on %s", kit.c_str());
                 if (!error.empty())
-                    mpr(error);
+                    mprf(MSGCH_ERROR, "%s", error.c_str());
+                completed = false;
                 break;
             }
         }
@@ -783,6 +1077,83 @@ void wizard_fight_sim(bool double_scale)
 
     _uninit_fsim(mon);
     mpr("Done.");
+    return completed;
+}
+
+/**
+ * Run a scale simulation from the command line (-fsim), without a game or
+ * wizard mode, as a new character of the given species and background
+ * (e.g. "MiFi"). The monster, mode, scale and kit come from the fsim_*
+ * options, the character's weapon from the weapon option, and the results
+ * are appended to fsim.txt or fsim.csv as with &F and &^F.
+ */
+NORETURN void fight_sim_batch(const string &combo, bool double_scale)
+{
+    _fsim_batch = true;
+
+    newgame_def ng;
+    ng.name = "fsim";
+    if (combo.size() == 4)
+    {
+        ng.species = get_species_by_abbrev(combo.substr(0, 2).c_str());
+        ng.job = get_job_by_abbrev(combo.substr(2, 2).c_str());
+    }
+    if (ng.species == SP_UNKNOWN || ng.job == JOB_UNKNOWN)
+    {
+        end(1, false, "-fsim needs a species and background such as MiFi, "
+                      "not '%s'.", combo.c_str());
+    }
+
+    if (get_monster_by_name(Options.fsim_mons, true) == MONS_PROGRAM_BUG)
+        end(1, false, "-fsim needs fsim_mons to name a monster.");
+
+    // There's nobody to ask.
+    if (Options.fsim_mode.find("defen") == string::npos)
+        Options.fsim_mode = "attack";
+
+    ng.weapon = Options.game.weapon;
+    if (ng.weapon == WPN_UNKNOWN || ng.weapon == WPN_RANDOM
+        || ng.weapon == WPN_VIABLE)
+    {
+        ng.weapon = WPN_UNARMED;
+    }
+
+    setup_game(ng);
+    you.save->unlink();
+    you.save = nullptr;
+
+    // Any level will do: wall the player into a corner of D:1, with a
+    // single square next to them for the monster. Whatever the builder put
+    // on the other squares around them is walled over or sent away.
+    you.goto_place(level_id(BRANCH_DUNGEON, 1));
+    {
+        no_messages mx;
+        env.map_knowledge.init(map_cell());
+        los_changed();
+        tile_init_default_flavour();
+        tile_clear_flavour();
+        tile_new_level(true);
+        builder();
+    }
+    const coord_def corner(2, 2), opening(2, 3);
+    dungeon_terrain_changed(corner, DNGN_FLOOR);
+    dungeon_terrain_changed(opening, DNGN_FLOOR);
+    for (adjacent_iterator ai(corner); ai; ++ai)
+    {
+        if (*ai == opening)
+            continue;
+        if (monster *mons = monster_at(*ai))
+            monster_die(*mons, KILL_DISMISSED, NON_MONSTER, true);
+        if (!feat_is_solid(grd(*ai)))
+            dungeon_terrain_changed(*ai, DNGN_ROCK_WALL);
+    }
+    if (monster *mons = monster_at(opening))
+        monster_die(*mons, KILL_DISMISSED, NON_MONSTER, true);
+    you.moveto(corner);
+
+    if (!wizard_fight_sim(double_scale))
+        end(1, false, "Fight simulation failed.");
+    end(0);
 }
 
 #endif
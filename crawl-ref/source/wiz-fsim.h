@@ -49,5 +49,6 @@ struct fight_data
 };
 
 void wizard_quick_fsim();
-void wizard_fight_sim(bool double_scale);
+bool wizard_fight_sim(bool double_scale);
+NORETURN void fight_sim_batch(const string &combo, bool double_scale);
 fight_data wizard_quick_fsim_raw(bool defend);